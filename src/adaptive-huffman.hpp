@@ -0,0 +1,140 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <stdexcept>
+
+#include "canonical-code.hpp"
+#include "bit-stream.hpp"
+
+// Adaptive byte model shared by the one-pass encoder and decoder. Instead
+// of updating a tree on every symbol (Vitter), the counts are updated per
+// symbol and the canonical code and its decode table are rebuilt every
+// few symbols. Both sides perform the same updates in lockstep, so no
+// table is ever stored in the compressed file.
+class AdaptiveHuffModel
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+
+public:
+	AdaptiveHuffModel()
+	{
+		// Every byte starts with a count of one, so any byte can be coded
+		// before it has been seen and no escape symbol is needed
+		byteFreqs.fill(1);
+		totalFreq = 256;
+		rebuild();
+	}
+
+	const CanonicalCode& getCode() const
+	{
+		return code;
+	}
+
+	const std::vector<DecodeEntry>& getDecodeTable() const
+	{
+		return decodeTable;
+	}
+
+	void update(Byte byte)
+	{
+		byteFreqs[byte]++;
+		totalFreq++;
+
+		if (--symbolsUntilRebuild == 0) {
+			rebuild();
+		}
+	}
+
+private:
+	static constexpr size_t MAX_CODE_LENGTH = 12;
+	static constexpr size_t FIRST_REBUILD_INTERVAL = 32;
+	static constexpr size_t REBUILD_INTERVAL = 4096;
+	static constexpr uint64_t MAX_TOTAL_FREQ = 1 << 16;
+
+	ByteFreqTable byteFreqs;
+	uint64_t totalFreq;
+	CanonicalCode code;
+	std::vector<DecodeEntry> decodeTable;
+	size_t rebuildInterval = FIRST_REBUILD_INTERVAL;
+	size_t symbolsUntilRebuild = 0;
+
+	void rebuild()
+	{
+		// Halve the counts once they grow large, so the model keeps
+		// following the input instead of freezing on its beginning
+		if (totalFreq > MAX_TOTAL_FREQ) {
+			totalFreq = 0;
+			for (uint64_t& freq : byteFreqs) {
+				freq = (freq + 1) / 2;
+				totalFreq += freq;
+			}
+		}
+
+		code = CanonicalCode(byteFreqs, MAX_CODE_LENGTH);
+		decodeTable = code.buildDecodeTable();
+
+		// Rebuild often while the model is still poor, then settle
+		symbolsUntilRebuild = rebuildInterval;
+		rebuildInterval = std::min(rebuildInterval * 2, REBUILD_INTERVAL);
+	}
+};
+
+class AdaptiveHuffEncoder
+{
+public:
+	AdaptiveHuffEncoder(BitWriter& writer)
+		: writer(writer)
+	{
+	}
+
+	void encode(const Byte* inBuff, size_t inBuffSize)
+	{
+		for (size_t i = 0; i < inBuffSize; i++) {
+			const CanonicalCode& code = model.getCode();
+			writer.writeBits(code.getCodes()[inBuff[i]], code.getLengths()[inBuff[i]]);
+			model.update(inBuff[i]);
+		}
+	}
+
+private:
+	BitWriter& writer;
+	AdaptiveHuffModel model;
+};
+
+class AdaptiveHuffDecoder
+{
+public:
+	AdaptiveHuffDecoder(BitReader& reader)
+		: reader(reader)
+	{
+	}
+
+	// Throws once the symbols run past the end of the input, which the 
+	// size in the header rules out for a complete file
+	void decode(Byte* outBuff, size_t outBuffSize)
+	{
+		for (size_t i = 0; i < outBuffSize; i++) {
+			size_t tableLog = model.getCode().getMaxLength();
+			DecodeEntry entry = model.getDecodeTable()[reader.peekBits(tableLog)];
+
+			if (entry.numBits == 0) {
+				throw std::runtime_error("Corrupted Huffman bitstream.");
+			}
+
+			reader.skipBits(entry.numBits);
+			outBuff[i] = entry.symbol;
+			model.update(entry.symbol);
+		}
+
+		if (reader.isOverrun()) {
+			throw std::runtime_error("Unexpected end of compressed file.");
+		}
+	}
+
+private:
+	BitReader& reader;
+	AdaptiveHuffModel model;
+};
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+using Byte = uint8_t;
+
+// Buffered MSB-first bit writer. Codes are appended to a 64-bit
+// accumulator and spilled one byte at a time, either to an output stream
+// or to the end of a byte vector.
+class BitWriter
+{
+public:
+	BitWriter(std::ostream& outStream)
+		: outStream(&outStream)
+	{
+	}
+
+	BitWriter(std::vector<Byte>& outBytes)
+		: outBytes(&outBytes)
+	{
+	}
+
+	~BitWriter()
+	{
+		flush();
+	}
+
+	// Appends the `numBits` lowest bits of `code` (at most 32).
+	void writeBits(uint32_t code, size_t numBits)
+	{
+		acc = (acc << numBits) | code;
+		bitCount += numBits;
+
+		while (bitCount >= 8) {
+			bitCount -= 8;
+			putByte(static_cast<Byte>(acc >> bitCount));
+		}
+	}
+
+	// Pads the last partial byte with zeros and writes everything out.
+	void flush()
+	{
+		if (bitCount > 0) {
+			putByte(static_cast<Byte>(acc << (8 - bitCount)));
+			bitCount = 0;
+		}
+
+		writeBuffer();
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = 1024;
+
+	std::ostream* outStream = nullptr;
+	std::vector<Byte>* outBytes = nullptr;
+	Byte buffer[BUFFER_SIZE];
+	size_t buffSize = 0;
+	uint64_t acc = 0;
+	size_t bitCount = 0;
+
+	void putByte(Byte byte)
+	{
+		buffer[buffSize++] = byte;
+
+		if (buffSize == BUFFER_SIZE) {
+			writeBuffer();
+		}
+	}
+
+	void writeBuffer()
+	{
+		if (outStream != nullptr) {
+			outStream->write(reinterpret_cast<char*>(buffer), buffSize);
+		}
+		else {
+			outBytes->insert(outBytes->end(), buffer, buffer + buffSize);
+		}
+
+		buffSize = 0;
+	}
+};
+
+// Buffered MSB-first bit reader over an input stream or a block of
+// memory. The valid bits are kept left-aligned in the accumulator, so
+// reading past the end of the input yields zeros; isOverrun() tells
+// whether any of those bits were consumed.
+class BitReader
+{
+public:
+	BitReader(std::istream& inStream)
+		: inStream(&inStream), buffer(storage)
+	{
+	}
+
+	BitReader(const Byte* bytes, size_t numBytes)
+		: buffer(bytes), buffSize(numBytes)
+	{
+	}
+
+	// Returns the next `numBits` bits (0 to 32) without consuming them.
+	uint32_t peekBits(size_t numBits)
+	{
+		if (bitCount < numBits) {
+			refill();
+		}
+
+		// Split shift, so that peeking zero bits is well defined
+		return static_cast<uint32_t>((acc >> 1) >> (63 - numBits));
+	}
+
+	void skipBits(size_t numBits)
+	{
+		acc <<= numBits;
+
+		if (numBits > bitCount) {
+			overrun = true;
+			bitCount = 0;
+		}
+		else {
+			bitCount -= numBits;
+		}
+	}
+
+	uint32_t readBits(size_t numBits)
+	{
+		uint32_t bits = peekBits(numBits);
+		skipBits(numBits);
+		return bits;
+	}
+
+	// True once a bit past the end of the input has been consumed
+	bool isOverrun() const
+	{
+		return overrun;
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = 1024;
+
+	std::istream* inStream = nullptr;
+	Byte storage[BUFFER_SIZE];
+	const Byte* buffer;
+	size_t buffPos = 0;
+	size_t buffSize = 0;
+	uint64_t acc = 0;
+	size_t bitCount = 0;
+	bool overrun = false;
+
+	void refill()
+	{
+		while (bitCount <= 56) {
+			if (buffPos == buffSize) {
+				if (inStream == nullptr) {
+					return;
+				}
+
+				inStream->read(reinterpret_cast<char*>(storage), BUFFER_SIZE);
+				buffSize = static_cast<size_t>(inStream->gcount());
+				buffPos = 0;
+
+				if (buffSize == 0) {
+					return;
+				}
+			}
+
+			acc |= static_cast<uint64_t>(buffer[buffPos++]) << (56 - bitCount);
+			bitCount += 8;
+		}
+	}
+};
\ No newline at end of file
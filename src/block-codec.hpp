@@ -0,0 +1,528 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+
+#include "canonical-code.hpp"
+#include "fse.hpp"
+#include "decode-table-cache.hpp"
+#include "container-format.hpp"
+#include "kernels.h"
+
+// Entropy coder used for the blocks of a compressed file
+enum class EntropyMode
+{
+	HUFFMAN,
+	FSE,
+	// Pick whichever coder gives the smaller block
+	AUTO
+};
+
+enum class BlockType : Byte
+{
+	RAW = 1,
+	HUFFMAN = 2,
+	FSE = 3,
+	INDEX = 4
+};
+
+// Location of a data block, as listed in a block index
+struct BlockIndexEntry
+{
+	uint64_t offset;
+	uint32_t rawSize;
+};
+
+// Tuning knobs of the block mode, usually taken from a compression level
+struct BlockSettings
+{
+	size_t blockSize = size_t(1) << 17;
+	size_t maxCodeLength = 12;
+	size_t fseTableLog = FseTable::DEFAULT_TABLE_LOG;
+	EntropyMode entropyMode = EntropyMode::AUTO;
+	// How much larger than the entropy bound of a block (in per mille)
+	// a previous table may code it before a new table is built for it.
+	// Negative values disable table reuse.
+	int reuseTolerance = 10;
+	// How many times a block may be halved when the halves code smaller
+	// with tables of their own, e.g. where the data changes mid-block
+	size_t splitDepth = 0;
+};
+
+// Every block has a header with the block type, the number of decoded 
+// bytes and the sizes of the table and the payload, followed by the table 
+// and the payload themselves. A coded block with an empty table reuses 
+// the table of the last block of the same type.
+//
+// The data blocks are followed by an INDEX block listing their offsets 
+// and sizes, along with the offset of the previous index. Appending to a 
+// file adds new blocks and a new index chained to the old one, so the 
+// existing blocks never have to be touched.
+class BlockEncoder
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+
+public:
+	static constexpr size_t MIN_BLOCK_SIZE = size_t(1) << 10;
+	static constexpr size_t MAX_BLOCK_SIZE = size_t(1) << 20;
+	static constexpr size_t MAX_SPLIT_DEPTH = 6;
+
+	static constexpr size_t BLOCK_HEADER_SIZE = 11;
+	static constexpr size_t INDEX_HEADER_SIZE = 13;
+	static constexpr size_t INDEX_ENTRY_SIZE = 12;
+
+	// Largest payload a block of `rawSize` bytes can have. Huffman codes 
+	// and FSE states take at most 15 bits per byte, plus the first state.
+	static uint64_t getMaxPayloadSize(BlockType type, uint64_t rawSize)
+	{
+		return (type == BlockType::RAW) ? rawSize : 
+			(rawSize * CanonicalCode::MAX_CODE_LENGTH + 7) / 8 + 8;
+	}
+
+	// `offset` is the position in the file of the first block written
+	BlockEncoder(std::ostream& outStream, const BlockSettings& settings, 
+		uint64_t offset = ContainerFormat::BLOCKS_HEADER_SIZE)
+		: outStream(outStream), settings(settings), offset(offset)
+	{
+		if (settings.blockSize < MIN_BLOCK_SIZE || settings.blockSize > MAX_BLOCK_SIZE) {
+			throw std::invalid_argument("Invalid block size.");
+		}
+		if (settings.splitDepth > MAX_SPLIT_DEPTH) {
+			throw std::invalid_argument("Invalid split depth.");
+		}
+	}
+
+	// Codes the block, in several pieces when splitting pays off
+	void encodeBlock(const Byte* inBuff, size_t inBuffSize)
+	{
+		if (settings.splitDepth == 0) {
+			encodeWholeBlock(inBuff, inBuffSize);
+			return;
+		}
+
+		ByteFreqTable byteFreqs{ 0 };
+		std::vector<size_t> pieceSizes;
+		planSplit(inBuff, inBuffSize, settings.splitDepth, byteFreqs, pieceSizes);
+
+		for (size_t pieceSize : pieceSizes) {
+			encodeWholeBlock(inBuff, pieceSize);
+			inBuff += pieceSize;
+		}
+	}
+
+	// Codes the block with the given Huffman code instead of choosing a 
+	// table for it. The table is only stored when it differs from the one 
+	// of the last Huffman block, and blocks the code would expand are 
+	// stored as is. Every byte of the block must have a code.
+	void encodeBlock(const Byte* inBuff, size_t inBuffSize, const CanonicalCode& code, 
+		const ByteFreqTable& byteFreqs)
+	{
+		bool reuseTable = hasHuffCode && huffCode.getLengths() == code.getLengths();
+		std::vector<Byte> table;
+
+		if (!reuseTable) {
+			BitWriter tableWriter(table);
+			code.writeTable(tableWriter);
+			tableWriter.flush();
+		}
+
+		if (code.getEncodedBits(byteFreqs) + table.size() * 8 >= uint64_t(inBuffSize) * 8) {
+			writeBlock(BlockType::RAW, inBuff, inBuffSize, {});
+			return;
+		}
+
+		huffCode = code;
+		hasHuffCode = true;
+		writeBlock(BlockType::HUFFMAN, inBuff, inBuffSize, table);
+	}
+
+	// Position in the file of the next block
+	uint64_t getOffset() const
+	{
+		return offset;
+	}
+
+	// Writes the index of the blocks written so far, chained to the index 
+	// at `prevIndexOffset` (0 if there is none), and returns its offset.
+	uint64_t finish(uint64_t prevIndexOffset = 0)
+	{
+		uint64_t indexOffset = offset;
+
+		ContainerFormat::writeUInt(outStream, static_cast<Byte>(BlockType::INDEX), 1);
+		ContainerFormat::writeUInt(outStream, prevIndexOffset, 8);
+		ContainerFormat::writeUInt(outStream, entries.size(), 4);
+
+		for (const BlockIndexEntry& entry : entries) {
+			ContainerFormat::writeUInt(outStream, entry.offset, 8);
+			ContainerFormat::writeUInt(outStream, entry.rawSize, 4);
+		}
+
+		offset += INDEX_HEADER_SIZE + entries.size() * INDEX_ENTRY_SIZE;
+		entries.clear();
+
+		return indexOffset;
+	}
+
+private:
+	std::ostream& outStream;
+	BlockSettings settings;
+	std::vector<Byte> payload;
+
+	// Position of the next block and the blocks that are not indexed yet
+	uint64_t offset;
+	std::vector<BlockIndexEntry> entries;
+
+	// Tables of the last Huffman and FSE blocks
+	CanonicalCode huffCode;
+	FseTable fseTable;
+	bool hasHuffCode = false;
+	bool hasFseTable = false;
+
+	// Codes the block with the table that suits it best
+	void encodeWholeBlock(const Byte* inBuff, size_t inBuffSize)
+	{
+		ByteFreqTable byteFreqs{ 0 };
+		Kernels::countBytes(inBuff, inBuffSize, byteFreqs);
+
+		BlockType type = BlockType::RAW;
+		bool reuseTable = false;
+		uint64_t bestBits = uint64_t(inBuffSize) * 8;
+
+		// Tables of previous blocks come for free. If one of them is close
+		// enough to the entropy of this block, building a new one isn't
+		// worth its time
+		if (settings.reuseTolerance >= 0) {
+			if (hasHuffCode && settings.entropyMode != EntropyMode::FSE &&
+				coversBlock(huffCode.getLengths(), byteFreqs)) {
+				considerBlockType(BlockType::HUFFMAN, true, huffCode.getEncodedBits(byteFreqs),
+					type, reuseTable, bestBits);
+			}
+
+			if (hasFseTable && settings.entropyMode != EntropyMode::HUFFMAN &&
+				coversBlock(fseTable.getNormCounts(), byteFreqs)) {
+				considerBlockType(BlockType::FSE, true, fseTable.getEncodedBits(byteFreqs),
+					type, reuseTable, bestBits);
+			}
+
+			uint64_t entropyBits = getEntropyBits(byteFreqs);
+
+			if (reuseTable && bestBits * 1000 <= entropyBits * (1000 + settings.reuseTolerance)) {
+				writeBlock(type, inBuff, inBuffSize, {});
+				return;
+			}
+		}
+
+		CanonicalCode newHuffCode;
+		FseTable newFseTable;
+		std::vector<Byte> huffTable, fseTableBytes;
+
+		if (settings.entropyMode != EntropyMode::FSE) {
+			newHuffCode = CanonicalCode(byteFreqs, settings.maxCodeLength);
+
+			BitWriter tableWriter(huffTable);
+			newHuffCode.writeTable(tableWriter);
+			tableWriter.flush();
+
+			considerBlockType(BlockType::HUFFMAN, false, 
+				newHuffCode.getEncodedBits(byteFreqs) + huffTable.size() * 8,
+				type, reuseTable, bestBits);
+		}
+
+		if (settings.entropyMode != EntropyMode::HUFFMAN) {
+			newFseTable = FseTable(byteFreqs, settings.fseTableLog);
+
+			BitWriter tableWriter(fseTableBytes);
+			newFseTable.writeTable(tableWriter);
+			tableWriter.flush();
+
+			considerBlockType(BlockType::FSE, false,
+				newFseTable.getEncodedBits(byteFreqs) + fseTableBytes.size() * 8,
+				type, reuseTable, bestBits);
+		}
+
+		if (type == BlockType::HUFFMAN && !reuseTable) {
+			huffCode = newHuffCode;
+			hasHuffCode = true;
+			writeBlock(type, inBuff, inBuffSize, huffTable);
+		}
+		else if (type == BlockType::FSE && !reuseTable) {
+			fseTable = newFseTable;
+			hasFseTable = true;
+			writeBlock(type, inBuff, inBuffSize, fseTableBytes);
+		}
+		else {
+			writeBlock(type, inBuff, inBuffSize, {});
+		}
+	}
+
+	// Splits the block in halves, recursively, as long as the halves are
+	// estimated to code smaller than the whole. Appends the sizes of the
+	// pieces, sets the byte counts of the block and returns its estimate.
+	uint64_t planSplit(const Byte* inBuff, size_t inBuffSize, size_t depth,
+		ByteFreqTable& byteFreqs, std::vector<size_t>& pieceSizes) const
+	{
+		if (depth == 0 || inBuffSize < 2 * MIN_BLOCK_SIZE) {
+			Kernels::countBytes(inBuff, inBuffSize, byteFreqs);
+			pieceSizes.push_back(inBuffSize);
+			return estimateBlockBits(byteFreqs, inBuffSize);
+		}
+
+		size_t halfSize = inBuffSize / 2;
+		size_t firstPiece = pieceSizes.size();
+		ByteFreqTable secondFreqs{ 0 };
+
+		uint64_t splitBits = planSplit(inBuff, halfSize, depth - 1, byteFreqs, pieceSizes) +
+			planSplit(inBuff + halfSize, inBuffSize - halfSize, depth - 1, secondFreqs, pieceSizes);
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			byteFreqs[byte] += secondFreqs[byte];
+		}
+
+		uint64_t wholeBits = estimateBlockBits(byteFreqs, inBuffSize);
+		if (wholeBits <= splitBits) {
+			pieceSizes.resize(firstPiece);
+			pieceSizes.push_back(inBuffSize);
+			return wholeBits;
+		}
+
+		return splitBits;
+	}
+
+	// Size of the block with a new table of its own, header and table
+	// included. Table reuse is left out, so pieces are judged alike.
+	uint64_t estimateBlockBits(const ByteFreqTable& byteFreqs, size_t inBuffSize) const
+	{
+		uint64_t bestBits = uint64_t(inBuffSize) * 8;
+
+		if (settings.entropyMode != EntropyMode::FSE) {
+			CanonicalCode code(byteFreqs, settings.maxCodeLength);
+			std::vector<Byte> table;
+
+			BitWriter tableWriter(table);
+			code.writeTable(tableWriter);
+			tableWriter.flush();
+
+			bestBits = std::min(bestBits, code.getEncodedBits(byteFreqs) + table.size() * 8);
+		}
+
+		if (settings.entropyMode != EntropyMode::HUFFMAN) {
+			FseTable table(byteFreqs, settings.fseTableLog);
+			std::vector<Byte> tableBytes;
+
+			BitWriter tableWriter(tableBytes);
+			table.writeTable(tableWriter);
+			tableWriter.flush();
+
+			bestBits = std::min(bestBits, table.getEncodedBits(byteFreqs) + tableBytes.size() * 8);
+		}
+
+		return bestBits + BLOCK_HEADER_SIZE * 8;
+	}
+
+	static void considerBlockType(BlockType candidateType, bool candidateReuse, 
+		uint64_t candidateBits, BlockType& type, bool& reuseTable, uint64_t& bestBits)
+	{
+		if (candidateBits < bestBits) {
+			type = candidateType;
+			reuseTable = candidateReuse;
+			bestBits = candidateBits;
+		}
+	}
+
+	// Whether every byte present in the block has a code in the table
+	template <typename T>
+	static bool coversBlock(const std::array<T, 256>& table, const ByteFreqTable& byteFreqs)
+	{
+		for (size_t byte = 0; byte < 256; byte++) {
+			if (byteFreqs[byte] > 0 && table[byte] == 0) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Shannon bound on the number of bits needed to code the histogram
+	static uint64_t getEntropyBits(const ByteFreqTable& byteFreqs)
+	{
+		uint64_t total = 0;
+		for (uint64_t freq : byteFreqs) {
+			total += freq;
+		}
+
+		double bits = 0;
+		for (uint64_t freq : byteFreqs) {
+			if (freq > 0) {
+				bits += freq * std::log2(static_cast<double>(total) / freq);
+			}
+		}
+
+		return static_cast<uint64_t>(bits);
+	}
+
+	// Codes the block with the current table of the given type and 
+	// writes it along with `table`, which is empty when a table is reused
+	void writeBlock(BlockType type, const Byte* inBuff, size_t inBuffSize, 
+		const std::vector<Byte>& table)
+	{
+		payload.clear();
+
+		if (type == BlockType::HUFFMAN) {
+			Kernels::encodeHuffman(inBuff, inBuffSize, huffCode, payload);
+		}
+		else if (type == BlockType::FSE) {
+			BitWriter writer(payload);
+			FseEncoder::encode(inBuff, inBuffSize, fseTable, writer);
+			writer.flush();
+		}
+		else {
+			// Incompressible data is stored as is
+			payload.assign(inBuff, inBuff + inBuffSize);
+		}
+
+		ContainerFormat::writeUInt(outStream, static_cast<Byte>(type), 1);
+		ContainerFormat::writeUInt(outStream, inBuffSize, 4);
+		ContainerFormat::writeUInt(outStream, table.size(), 2);
+		ContainerFormat::writeUInt(outStream, payload.size(), 4);
+
+		outStream.write(reinterpret_cast<const char*>(table.data()), table.size());
+		outStream.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+		entries.push_back({ offset, static_cast<uint32_t>(inBuffSize) });
+		offset += BLOCK_HEADER_SIZE + table.size() + payload.size();
+	}
+};
+
+class BlockDecoder
+{
+public:
+	// Reads the rest of the file header, up to the first block. Decoding
+	// tables are taken from `cache` when one is given.
+	BlockDecoder(std::istream& inStream, DecodeTableCache* cache = nullptr)
+		: inStream(inStream), cache(cache)
+	{
+		indexOffset = ContainerFormat::readUInt(inStream, 8);
+		offset = ContainerFormat::BLOCKS_HEADER_SIZE;
+	}
+
+	// Decodes the next data block into `outBuff`. Indexes left behind by 
+	// earlier appends are skipped. Returns false once the last index, the 
+	// one referenced by the file header, has been reached.
+	bool decodeBlock(std::vector<Byte>& outBuff)
+	{
+		uint64_t blockOffset = offset;
+
+		if (blockOffset > indexOffset) {
+			throw std::runtime_error("Corrupted block index.");
+		}
+
+		BlockType type = static_cast<BlockType>(readField(1));
+
+		while (type == BlockType::INDEX) {
+			readField(8);
+			uint64_t numEntries = readField(4);
+			skipBytes(numEntries * BlockEncoder::INDEX_ENTRY_SIZE);
+
+			if (blockOffset == indexOffset) {
+				return false;
+			}
+
+			blockOffset = offset;
+			type = static_cast<BlockType>(readField(1));
+		}
+
+		size_t rawSize = readField(4);
+		size_t tableSize = readField(2);
+		size_t payloadSize = readField(4);
+
+		// Checked before anything is allocated for the block
+		if (rawSize > BlockEncoder::MAX_BLOCK_SIZE || 
+			payloadSize > BlockEncoder::getMaxPayloadSize(type, rawSize) ||
+			(type == BlockType::RAW && payloadSize != rawSize)) {
+			throw std::runtime_error("Corrupted block header.");
+		}
+
+		readBytes(table, tableSize);
+		readBytes(payload, payloadSize);
+		outBuff.resize(rawSize);
+
+		BitReader reader(payload.data(), payload.size());
+
+		switch (type) {
+		case BlockType::RAW:
+			std::copy(payload.begin(), payload.end(), outBuff.begin());
+			break;
+		case BlockType::HUFFMAN:
+			if (tableSize > 0) {
+				huffTable = (cache != nullptr) ? cache->getHuffman(table) : 
+					DecodeTables::buildHuffman(table);
+			}
+			else if (huffTable == nullptr) {
+				throw std::runtime_error("Block reuses a missing Huffman table.");
+			}
+			Kernels::decodeHuffman(payload.data(), payload.size(), huffTable->entries, 
+				huffTable->tableLog, outBuff.data(), rawSize);
+			break;
+		case BlockType::FSE:
+			if (tableSize > 0) {
+				fseTable = (cache != nullptr) ? cache->getFse(table) : 
+					DecodeTables::buildFse(table);
+			}
+			else if (fseTable == nullptr) {
+				throw std::runtime_error("Block reuses a missing FSE table.");
+			}
+			FseDecoder::decode(reader, fseTable->entries, fseTable->tableLog, 
+				outBuff.data(), rawSize);
+			break;
+		default:
+			throw std::runtime_error("Unknown block type.");
+		}
+
+		return true;
+	}
+
+private:
+	std::istream& inStream;
+	DecodeTableCache* cache;
+	std::vector<Byte> table, payload;
+	uint64_t indexOffset;
+	uint64_t offset;
+
+	// Decoding tables of the last Huffman and FSE blocks
+	std::shared_ptr<const HuffDecodeTable> huffTable;
+	std::shared_ptr<const FseDecodeTable> fseTable;
+
+	uint64_t readField(size_t numBytes)
+	{
+		offset += numBytes;
+		return ContainerFormat::readUInt(inStream, numBytes);
+	}
+
+	void readBytes(std::vector<Byte>& bytes, size_t numBytes)
+	{
+		bytes.resize(numBytes);
+
+		if (!inStream.read(reinterpret_cast<char*>(bytes.data()), numBytes)) {
+			throw std::runtime_error("Unexpected end of compressed file.");
+		}
+
+		offset += numBytes;
+	}
+
+	// Skips the index entries, which decoding doesn't need, without
+	// buffering them
+	void skipBytes(uint64_t numBytes)
+	{
+		if (!inStream.ignore(static_cast<std::streamsize>(numBytes)) || 
+			static_cast<uint64_t>(inStream.gcount()) != numBytes) {
+			throw std::runtime_error("Unexpected end of compressed file.");
+		}
+
+		offset += numBytes;
+	}
+};
\ No newline at end of file
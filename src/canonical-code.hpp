@@ -0,0 +1,284 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "bit-stream.hpp"
+
+// Entry of a table-driven decoder: the symbol whose code prefixes the
+// looked-up bits and the number of bits that code actually takes.
+struct DecodeEntry
+{
+	Byte symbol;
+	Byte numBits;
+};
+
+// Length-limited canonical Huffman code. Only the code lengths are needed
+// to rebuild the codes, which keeps the stored tables small and lets
+// the decoder resolve a symbol with a single table lookup.
+class CanonicalCode
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+
+public:
+	static constexpr size_t MAX_CODE_LENGTH = 15;
+
+	CanonicalCode()
+	{
+	}
+
+	CanonicalCode(const ByteFreqTable& byteFreqs, size_t maxLength = MAX_CODE_LENGTH)
+	{
+		if (maxLength == 0 || maxLength > MAX_CODE_LENGTH) {
+			throw std::invalid_argument("Invalid maximum code length.");
+		}
+
+		computeLengths(byteFreqs, maxLength);
+		assignCodes();
+	}
+
+	static CanonicalCode fromLengths(const std::array<Byte, 256>& codeLengths)
+	{
+		CanonicalCode code;
+		code.lengths = codeLengths;
+
+		uint64_t kraftSum = 0;
+		for (Byte length : code.lengths) {
+			if (length > MAX_CODE_LENGTH) {
+				throw std::runtime_error("Corrupted code length table.");
+			}
+			if (length > 0) {
+				kraftSum += 1ull << (MAX_CODE_LENGTH - length);
+			}
+		}
+
+		if (kraftSum > (1ull << MAX_CODE_LENGTH)) {
+			throw std::runtime_error("Corrupted code length table.");
+		}
+
+		code.assignCodes();
+		return code;
+	}
+
+	const std::array<Byte, 256>& getLengths() const
+	{
+		return lengths;
+	}
+
+	const std::array<uint16_t, 256>& getCodes() const
+	{
+		return codes;
+	}
+
+	// Length of the longest code, which is also the number of bits the
+	// decoder has to peek for a table lookup.
+	size_t getMaxLength() const
+	{
+		return maxLength;
+	}
+
+	// Builds the lookup table indexed by the next getMaxLength() bits.
+	std::vector<DecodeEntry> buildDecodeTable() const
+	{
+		std::vector<DecodeEntry> table(size_t(1) << maxLength, DecodeEntry{ 0, 0 });
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			size_t length = lengths[byte];
+
+			if (length == 0) {
+				continue;
+			}
+
+			size_t first = size_t(codes[byte]) << (maxLength - length);
+			size_t last = first + (size_t(1) << (maxLength - length));
+
+			for (size_t i = first; i < last; i++) {
+				table[i] = { static_cast<Byte>(byte), static_cast<Byte>(length) };
+			}
+		}
+
+		return table;
+	}
+
+	// Writes the code lengths, 4 bits each, up to the last coded byte.
+	void writeTable(BitWriter& writer) const
+	{
+		size_t lastSymbol = 255;
+		while (lastSymbol > 0 && lengths[lastSymbol] == 0) {
+			lastSymbol--;
+		}
+
+		writer.writeBits(static_cast<uint32_t>(lastSymbol), 8);
+
+		for (size_t byte = 0; byte <= lastSymbol; byte++) {
+			writer.writeBits(lengths[byte], 4);
+		}
+	}
+
+	static CanonicalCode readTable(BitReader& reader)
+	{
+		std::array<Byte, 256> codeLengths{ 0 };
+		size_t lastSymbol = reader.readBits(8);
+
+		for (size_t byte = 0; byte <= lastSymbol; byte++) {
+			codeLengths[byte] = static_cast<Byte>(reader.readBits(4));
+		}
+
+		return fromLengths(codeLengths);
+	}
+
+	// Number of bits needed to encode the given histogram with this code.
+	uint64_t getEncodedBits(const ByteFreqTable& byteFreqs) const
+	{
+		uint64_t total = 0;
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			total += byteFreqs[byte] * lengths[byte];
+		}
+
+		return total;
+	}
+
+private:
+	std::array<Byte, 256> lengths{ 0 };
+	std::array<uint16_t, 256> codes{ 0 };
+	size_t maxLength = 0;
+
+	void computeLengths(const ByteFreqTable& byteFreqs, size_t maxLength)
+	{
+		std::vector<Byte> symbols;
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			if (byteFreqs[byte] > 0) {
+				symbols.push_back(static_cast<Byte>(byte));
+			}
+		}
+
+		if (symbols.empty()) {
+			return;
+		}
+
+		if (symbols.size() == 1) {
+			// A lone symbol still needs one bit so the decoder can advance
+			lengths[symbols[0]] = 1;
+			return;
+		}
+
+		std::stable_sort(symbols.begin(), symbols.end(), [&](Byte a, Byte b) {
+			return byteFreqs[a] < byteFreqs[b];
+		});
+
+		// Two-queue Huffman construction over the sorted leaves: internal
+		// nodes are created in non-decreasing weight order, so the smallest
+		// pending node is always at the front of one of the two queues.
+		size_t numLeaves = symbols.size();
+		std::vector<uint64_t> weights(2 * numLeaves - 1);
+		std::vector<size_t> parents(2 * numLeaves - 1, 0);
+
+		for (size_t i = 0; i < numLeaves; i++) {
+			weights[i] = byteFreqs[symbols[i]];
+		}
+
+		size_t nextLeaf = 0;
+		size_t nextNode = numLeaves;
+
+		auto popMin = [&](size_t nodeEnd) {
+			if (nextLeaf < numLeaves &&
+				(nextNode >= nodeEnd || weights[nextLeaf] <= weights[nextNode])) {
+				return nextLeaf++;
+			}
+			return nextNode++;
+		};
+
+		for (size_t node = numLeaves; node < 2 * numLeaves - 1; node++) {
+			size_t left = popMin(node);
+			size_t right = popMin(node);
+
+			weights[node] = weights[left] + weights[right];
+			parents[left] = node;
+			parents[right] = node;
+		}
+
+		// Depth of each node, computed from the root downwards
+		std::vector<size_t> depths(2 * numLeaves - 1, 0);
+		std::array<size_t, 64> lengthCounts{ 0 };
+
+		for (size_t node = 2 * numLeaves - 2; node-- > 0; ) {
+			depths[node] = depths[parents[node]] + 1;
+		}
+
+		for (size_t i = 0; i < numLeaves; i++) {
+			lengthCounts[std::min<size_t>(depths[i], 63)]++;
+		}
+
+		limitLengths(lengthCounts, maxLength);
+
+		// The most frequent symbols (at the end of the sorted vector) take
+		// the shortest lengths
+		size_t idx = numLeaves;
+		for (size_t length = 1; length <= maxLength; length++) {
+			for (size_t i = 0; i < lengthCounts[length]; i++) {
+				lengths[symbols[--idx]] = static_cast<Byte>(length);
+			}
+		}
+	}
+
+	// Folds every code longer than `maxLength` into `maxLength` and then
+	// lengthens the deepest shorter codes until the Kraft sum is exact again.
+	static void limitLengths(std::array<size_t, 64>& lengthCounts, size_t maxLength)
+	{
+		for (size_t length = maxLength + 1; length < 64; length++) {
+			lengthCounts[maxLength] += lengthCounts[length];
+			lengthCounts[length] = 0;
+		}
+
+		uint64_t kraftSum = 0;
+		for (size_t length = 1; length <= maxLength; length++) {
+			kraftSum += uint64_t(lengthCounts[length]) << (maxLength - length);
+		}
+
+		while (kraftSum > (1ull << maxLength)) {
+			lengthCounts[maxLength]--;
+
+			for (size_t length = maxLength - 1; length > 0; length--) {
+				if (lengthCounts[length] > 0) {
+					lengthCounts[length]--;
+					lengthCounts[length + 1] += 2;
+					break;
+				}
+			}
+
+			kraftSum--;
+		}
+	}
+
+	void assignCodes()
+	{
+		std::array<uint16_t, MAX_CODE_LENGTH + 2> nextCode{ 0 };
+		std::array<size_t, MAX_CODE_LENGTH + 1> lengthCounts{ 0 };
+
+		maxLength = 0;
+		for (Byte length : lengths) {
+			lengthCounts[length]++;
+			maxLength = std::max<size_t>(maxLength, length);
+		}
+		lengthCounts[0] = 0;
+
+		uint16_t code = 0;
+		for (size_t length = 1; length <= MAX_CODE_LENGTH; length++) {
+			code = static_cast<uint16_t>((code + lengthCounts[length - 1]) << 1);
+			nextCode[length] = code;
+		}
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			if (lengths[byte] > 0) {
+				codes[byte] = nextCode[lengths[byte]]++;
+			}
+		}
+	}
+};
\ No newline at end of file
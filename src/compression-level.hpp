@@ -0,0 +1,129 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <stdexcept>
+
+#include "block-codec.hpp"
+
+// Presets of the block mode, from 1 (fastest) to 9 (best ratio). Lower
+// levels use shorter codes (smaller decoding tables), Huffman only and
+// eager table reuse; higher levels let each block pick between Huffman
+// and FSE and reuse a table only when it really is as good as a new one.
+// The top levels start from larger blocks and split them where the data
+// changes, so uniform data keeps the few tables it needs.
+class CompressionLevel
+{
+private:
+	// Alias declarations
+	using string = std::string;
+	using ios = std::ios;
+
+public:
+	static constexpr int MIN_LEVEL = 1;
+	static constexpr int MAX_LEVEL = 9;
+	static constexpr int DEFAULT_LEVEL = 6;
+	static constexpr double DEFAULT_TARGET_MBPS = 100.0;
+
+	static BlockSettings getSettings(int level)
+	{
+		if (level < MIN_LEVEL || level > MAX_LEVEL) {
+			throw std::invalid_argument("Invalid compression level.");
+		}
+
+		// { blockSize, maxCodeLength, fseTableLog, entropyMode, reuseTolerance, splitDepth }
+		static const std::array<BlockSettings, MAX_LEVEL> presets = { {
+			{ size_t(1) << 18, 11, 10, EntropyMode::HUFFMAN, 100 },
+			{ size_t(1) << 18, 11, 10, EntropyMode::HUFFMAN, 50 },
+			{ size_t(1) << 17, 11, 11, EntropyMode::HUFFMAN, 25 },
+			{ size_t(1) << 17, 11, 11, EntropyMode::AUTO, 25 },
+			{ size_t(1) << 17, 12, 11, EntropyMode::AUTO, 15 },
+			{ size_t(1) << 17, 12, 11, EntropyMode::AUTO, 10 },
+			{ size_t(1) << 17, 12, 12, EntropyMode::AUTO, 5, 2 },
+			{ size_t(1) << 18, 13, 12, EntropyMode::AUTO, 2, 4 },
+			{ size_t(1) << 19, 15, 12, EntropyMode::AUTO, 0, 6 }
+		} };
+
+		return presets[level - 1];
+	}
+
+	// Compresses a sample of the input at every level, from the best
+	// ratio down, and returns the first level fast enough to reach the
+	// target throughput (in MB/s). Falls back to the fastest level.
+	static int pickLevel(const string& inFilePath, double targetMBps = DEFAULT_TARGET_MBPS)
+	{
+		std::vector<Byte> sample = readSample(inFilePath);
+
+		if (sample.empty()) {
+			return DEFAULT_LEVEL;
+		}
+
+		for (int level = MAX_LEVEL; level > MIN_LEVEL; level--) {
+			if (measureThroughput(sample, getSettings(level)) >= targetMBps) {
+				return level;
+			}
+		}
+
+		return MIN_LEVEL;
+	}
+
+private:
+	static constexpr size_t SAMPLE_SLICES = 4;
+	static constexpr size_t SAMPLE_SLICE_SIZE = size_t(1) << 18;
+
+	CompressionLevel()
+	{
+	}
+
+	// Reads a few slices evenly spread over the input, so the sample
+	// isn't biased towards the beginning of the file.
+	static std::vector<Byte> readSample(const string& inFilePath)
+	{
+		std::ifstream inFile(inFilePath, ios::binary);
+		if (!inFile.is_open()) {
+			throw std::runtime_error("Failed to open file: " + inFilePath);
+		}
+
+		inFile.seekg(0, ios::end);
+		uint64_t fileSize = static_cast<uint64_t>(inFile.tellg());
+
+		// Small files are sampled whole
+		size_t numSlices = SAMPLE_SLICES;
+		uint64_t sliceSize = SAMPLE_SLICE_SIZE;
+
+		if (fileSize <= SAMPLE_SLICES * SAMPLE_SLICE_SIZE) {
+			numSlices = 1;
+			sliceSize = fileSize;
+		}
+
+		uint64_t stride = fileSize / numSlices;
+		std::vector<Byte> sample(static_cast<size_t>(numSlices * sliceSize));
+
+		for (size_t i = 0; i < numSlices; i++) {
+			inFile.seekg(i * stride, ios::beg);
+			inFile.read(reinterpret_cast<char*>(sample.data() + i * sliceSize), sliceSize);
+		}
+
+		return sample;
+	}
+
+	static double measureThroughput(const std::vector<Byte>& sample, const BlockSettings& settings)
+	{
+		std::ostringstream outStream;
+		BlockEncoder encoder(outStream, settings);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (size_t pos = 0; pos < sample.size(); pos += settings.blockSize) {
+			encoder.encodeBlock(sample.data() + pos, std::min(settings.blockSize, sample.size() - pos));
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		return sample.size() / 1e6 / std::max(elapsed.count(), 1e-9);
+	}
+};
\ No newline at end of file
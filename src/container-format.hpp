@@ -0,0 +1,80 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+
+using Byte = uint8_t;
+
+// Compressed files written by the newer coding modes start with a small
+// header: the "HZ" magic followed by a byte identifying the mode. Files
+// without the magic are in the original format (frequency table followed
+// by the bitstream). The original format can never start with "HZ", as its
+// second byte is the size of a frequency value, which is at most 8.
+namespace ContainerFormat
+{
+constexpr Byte MAGIC[2] = { 'H', 'Z' };
+
+enum class Mode : Byte
+{
+	ADAPTIVE = 1,
+	BLOCKS = 2
+};
+
+// In block mode the header is followed by the offset of the last block 
+// index. Rewriting this single field is what commits an append.
+constexpr size_t INDEX_OFFSET_POS = 3;
+constexpr size_t BLOCKS_HEADER_SIZE = 11;
+
+// Writes `numBytes` bytes of `value`, most significant byte first.
+inline void writeUInt(std::ostream& outStream, uint64_t value, size_t numBytes)
+{
+	for (size_t i = numBytes; i-- > 0; ) {
+		char byte = static_cast<char>((value >> (8 * i)) & 0xFF);
+		outStream.write(&byte, 1);
+	}
+}
+
+inline uint64_t readUInt(std::istream& inStream, size_t numBytes)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < numBytes; i++) {
+		Byte byte;
+		if (!inStream.read(reinterpret_cast<char*>(&byte), 1)) {
+			throw std::runtime_error("Unexpected end of compressed file.");
+		}
+		value = (value << 8) | byte;
+	}
+
+	return value;
+}
+
+inline void writeHeader(std::ostream& outStream, Mode mode)
+{
+	Byte header[3] = { MAGIC[0], MAGIC[1], static_cast<Byte>(mode) };
+	outStream.write(reinterpret_cast<char*>(header), 3);
+}
+
+// Reads the header if the stream has one. Otherwise the stream is
+// rewound to its beginning and false is returned.
+inline bool readHeader(std::istream& inStream, Mode& mode)
+{
+	Byte header[3];
+	inStream.read(reinterpret_cast<char*>(header), 3);
+
+	if (inStream.gcount() != 3 || header[0] != MAGIC[0] || header[1] != MAGIC[1]) {
+		inStream.clear();
+		inStream.seekg(0, std::ios::beg);
+		return false;
+	}
+
+	if (header[2] != static_cast<Byte>(Mode::ADAPTIVE) && 
+		header[2] != static_cast<Byte>(Mode::BLOCKS)) {
+		throw std::runtime_error("Unsupported compressed file format.");
+	}
+
+	mode = static_cast<Mode>(header[2]);
+	return true;
+}
+}
\ No newline at end of file
@@ -0,0 +1,892 @@
+#include "daemon.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <iostream>
+#include <streambuf>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace
+{
+enum class DaemonOp : Byte
+{
+	ZIP = 1,
+	UNZIP = 2,
+	STATS = 3
+};
+
+// Request: operation, compression mode and block settings. The input and
+// output descriptors travel along as SCM_RIGHTS ancillary data.
+constexpr size_t REQUEST_SIZE = 12;
+constexpr size_t NUM_REQUEST_FDS = 2;
+
+// Response: status, message length and message (error text or metrics)
+constexpr Byte STATUS_OK = 0;
+constexpr Byte STATUS_ERROR = 1;
+
+constexpr int LISTEN_BACKLOG = 128;
+// How long an open connection may wait for its next request
+constexpr int CLIENT_TIMEOUT_SECONDS = 30;
+constexpr int POLL_INTERVAL_MS = 1000;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void handleStopSignal(int)
+{
+	stopRequested = 1;
+}
+
+std::runtime_error systemError(const std::string& what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Stream buffer over a file descriptor, so the compressors can work on
+// descriptors received from clients. Seeking is forwarded to lseek, which
+// requires a regular file or a memfd.
+class FdStreamBuf : public std::streambuf
+{
+public:
+	FdStreamBuf(int fd)
+		: fd(fd), inBuff(BUFFER_SIZE), outBuff(BUFFER_SIZE)
+	{
+		setg(inBuff.data(), inBuff.data(), inBuff.data());
+		setp(outBuff.data(), outBuff.data() + outBuff.size());
+	}
+
+	~FdStreamBuf()
+	{
+		flushOutput();
+	}
+
+protected:
+	int_type underflow() override
+	{
+		ssize_t bytesRead;
+
+		do {
+			bytesRead = ::read(fd, inBuff.data(), inBuff.size());
+		} while (bytesRead < 0 && errno == EINTR);
+
+		if (bytesRead <= 0) {
+			return traits_type::eof();
+		}
+
+		setg(inBuff.data(), inBuff.data(), inBuff.data() + bytesRead);
+		return traits_type::to_int_type(*gptr());
+	}
+
+	int_type overflow(int_type ch) override
+	{
+		if (flushOutput() < 0) {
+			return traits_type::eof();
+		}
+
+		if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+
+		return traits_type::not_eof(ch);
+	}
+
+	int sync() override
+	{
+		return flushOutput();
+	}
+
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override
+	{
+		if (flushOutput() < 0) {
+			return pos_type(off_type(-1));
+		}
+
+		// The descriptor is ahead of the reader by the buffered bytes
+		if (dir == std::ios_base::cur) {
+			off -= egptr() - gptr();
+		}
+		setg(inBuff.data(), inBuff.data(), inBuff.data());
+
+		int whence = (dir == std::ios_base::beg) ? SEEK_SET :
+			(dir == std::ios_base::cur) ? SEEK_CUR : SEEK_END;
+		off_t pos = ::lseek(fd, off, whence);
+
+		return (pos < 0) ? pos_type(off_type(-1)) : pos_type(pos);
+	}
+
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+	{
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+
+private:
+	static constexpr size_t BUFFER_SIZE = size_t(1) << 16;
+
+	int fd;
+	std::vector<char> inBuff, outBuff;
+
+	int flushOutput()
+	{
+		const char* data = pbase();
+		size_t size = pptr() - pbase();
+
+		while (size > 0) {
+			ssize_t written = ::write(fd, data, size);
+
+			if (written < 0 && errno == EINTR) {
+				continue;
+			}
+			if (written <= 0) {
+				return -1;
+			}
+
+			data += written;
+			size -= written;
+		}
+
+		setp(outBuff.data(), outBuff.data() + outBuff.size());
+		return 0;
+	}
+};
+
+void encodeRequest(Byte* request, DaemonOp op, const CompressionOptions& options)
+{
+	const BlockSettings& settings = options.blockSettings;
+	uint32_t blockSize = static_cast<uint32_t>(settings.blockSize);
+	uint16_t reuseTolerance = static_cast<uint16_t>(settings.reuseTolerance);
+
+	request[0] = static_cast<Byte>(op);
+	request[1] = static_cast<Byte>(options.mode);
+	request[2] = static_cast<Byte>(blockSize >> 24);
+	request[3] = static_cast<Byte>(blockSize >> 16);
+	request[4] = static_cast<Byte>(blockSize >> 8);
+	request[5] = static_cast<Byte>(blockSize);
+	request[6] = static_cast<Byte>(settings.maxCodeLength);
+	request[7] = static_cast<Byte>(settings.fseTableLog);
+	request[8] = static_cast<Byte>(settings.entropyMode);
+	request[9] = static_cast<Byte>(reuseTolerance >> 8);
+	request[10] = static_cast<Byte>(reuseTolerance);
+	request[11] = static_cast<Byte>(settings.splitDepth);
+}
+
+CompressionOptions decodeOptions(const Byte* request)
+{
+	CompressionOptions options;
+	BlockSettings& settings = options.blockSettings;
+
+	if (request[1] > static_cast<Byte>(CompressionMode::SAMPLED) ||
+		request[8] > static_cast<Byte>(EntropyMode::AUTO)) {
+		throw std::runtime_error("Invalid daemon request.");
+	}
+
+	options.mode = static_cast<CompressionMode>(request[1]);
+	settings.blockSize = (size_t(request[2]) << 24) | (size_t(request[3]) << 16) |
+		(size_t(request[4]) << 8) | request[5];
+	settings.maxCodeLength = request[6];
+	settings.fseTableLog = request[7];
+	settings.entropyMode = static_cast<EntropyMode>(request[8]);
+	settings.reuseTolerance = static_cast<int16_t>((request[9] << 8) | request[10]);
+	settings.splitDepth = request[11];
+
+	return options;
+}
+
+void sendAll(int sock, const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+
+	while (size > 0) {
+		ssize_t sent = ::send(sock, bytes, size, MSG_NOSIGNAL);
+
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			throw systemError("Failed to send to the daemon socket");
+		}
+
+		bytes += sent;
+		size -= sent;
+	}
+}
+
+void receiveAll(int sock, void* data, size_t size, int flags = 0)
+{
+	char* bytes = static_cast<char*>(data);
+
+	while (size > 0) {
+		ssize_t received = ::recv(sock, bytes, size, flags);
+
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received < 0) {
+			throw systemError("Failed to receive from the daemon socket");
+		}
+		if (received == 0) {
+			throw std::runtime_error("The daemon socket was closed unexpectedly.");
+		}
+
+		bytes += received;
+		size -= received;
+	}
+}
+
+void sendRequest(int sock, const Byte* request, const int* fds, size_t numFds)
+{
+	iovec iov = { const_cast<Byte*>(request), REQUEST_SIZE };
+	char control[CMSG_SPACE(sizeof(int) * NUM_REQUEST_FDS)] = {};
+
+	msghdr message = {};
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+
+	if (numFds > 0) {
+		message.msg_control = control;
+		message.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+
+		cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+		std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * numFds);
+	}
+
+	ssize_t sent;
+	do {
+		sent = ::sendmsg(sock, &message, MSG_NOSIGNAL);
+	} while (sent < 0 && errno == EINTR);
+
+	if (sent < 0) {
+		throw systemError("Failed to send to the daemon socket");
+	}
+
+	sendAll(sock, request + sent, REQUEST_SIZE - sent);
+}
+
+// Receives a request and the descriptors attached to it. Returns the
+// number of descriptors, which the caller then owns.
+size_t receiveRequest(int sock, Byte* request, int* fds, int flags = 0)
+{
+	iovec iov = { request, REQUEST_SIZE };
+	char control[CMSG_SPACE(sizeof(int) * NUM_REQUEST_FDS)] = {};
+
+	msghdr message = {};
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t received;
+	do {
+		received = ::recvmsg(sock, &message, flags);
+	} while (received < 0 && errno == EINTR);
+
+	if (received <= 0) {
+		throw std::runtime_error("Invalid daemon request.");
+	}
+
+	size_t numFds = 0;
+
+	for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+			numFds = std::min((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), NUM_REQUEST_FDS);
+			std::memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * numFds);
+		}
+	}
+
+	try {
+		receiveAll(sock, request + received, REQUEST_SIZE - received, flags);
+	}
+	catch (std::exception&) {
+		for (size_t i = 0; i < numFds; i++) {
+			::close(fds[i]);
+		}
+		throw;
+	}
+
+	return numFds;
+}
+
+// Sent in a single call, so that on the daemon's non-blocking sockets a
+// response either fits in the socket buffer or fails as a whole
+void sendResponse(int sock, Byte status, const std::string& message)
+{
+	std::string response = { static_cast<char>(status),
+		static_cast<char>(message.size() >> 24), static_cast<char>(message.size() >> 16),
+		static_cast<char>(message.size() >> 8), static_cast<char>(message.size()) };
+	response += message;
+
+	sendAll(sock, response.data(), response.size());
+}
+
+// Returns the message of a successful response and throws on errors.
+std::string receiveResponse(int sock)
+{
+	Byte header[5];
+	receiveAll(sock, header, sizeof(header));
+
+	size_t size = (size_t(header[1]) << 24) | (size_t(header[2]) << 16) |
+		(size_t(header[3]) << 8) | header[4];
+	std::string message(size, '\0');
+	receiveAll(sock, message.data(), size);
+
+	if (header[0] != STATUS_OK) {
+		throw std::runtime_error(message);
+	}
+
+	return message;
+}
+
+class CompressionDaemon
+{
+private:
+	// Alias declarations
+	using string = std::string;
+	using Clock = std::chrono::steady_clock;
+
+public:
+	CompressionDaemon(const string& socketPath, size_t numWorkers)
+		: socketPath(socketPath), numWorkers(numWorkers)
+	{
+		if (this->numWorkers == 0) {
+			this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+		}
+	}
+
+	int run()
+	{
+		listen();
+		installSignalHandlers();
+
+		// Workers hand the connections they are done with back to the event 
+		// loop through this pipe, one descriptor per write
+		if (::pipe(returnFds) < 0) {
+			throw systemError("Failed to create pipe");
+		}
+		::fcntl(returnFds[0], F_SETFL, O_NONBLOCK);
+
+		for (size_t i = 0; i < numWorkers; i++) {
+			workers.emplace_back(&CompressionDaemon::workerLoop, this);
+		}
+
+		std::cout << "Listening on " << socketPath << " with " << numWorkers <<
+			" workers." << std::endl;
+
+		eventLoop();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobsAvailable.notify_all();
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+
+		receiveReturnedClients();
+		for (const IdleClient& client : idleClients) {
+			::close(client.fd);
+		}
+
+		::close(returnFds[0]);
+		::close(returnFds[1]);
+		::close(listenFd);
+		::unlink(socketPath.c_str());
+
+		return 0;
+	}
+
+private:
+	struct Job
+	{
+		int clientFd;
+		int inFd;
+		int outFd;
+		DaemonOp op;
+		CompressionOptions options;
+		Clock::time_point received;
+	};
+
+	// Open connection waiting for its next request
+	struct IdleClient
+	{
+		int fd;
+		Clock::time_point since;
+	};
+
+	string socketPath;
+	size_t numWorkers;
+	int listenFd = -1;
+	int returnFds[2] = { -1, -1 };
+
+	// Only touched by the event loop thread
+	std::vector<IdleClient> idleClients;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobsAvailable;
+	std::queue<Job> jobs;
+	bool stopping = false;
+
+	// Decoding tables shared by every worker
+	DecodeTableCache tableCache;
+
+	// Metrics
+	size_t maxQueueDepth = 0;
+	std::atomic<uint64_t> inFlight{ 0 };
+	std::atomic<uint64_t> completed{ 0 };
+	std::atomic<uint64_t> failed{ 0 };
+	std::atomic<uint64_t> totalLatencyUs{ 0 };
+	std::atomic<uint64_t> maxLatencyUs{ 0 };
+	// Output of the sampled mode and its size with full-histogram tables
+	std::atomic<uint64_t> sampledBytes{ 0 };
+	std::atomic<uint64_t> sampledFullTableBytes{ 0 };
+
+	void listen()
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+
+		if (socketPath.size() >= sizeof(address.sun_path)) {
+			throw std::runtime_error("Socket path is too long: " + socketPath);
+		}
+		std::strcpy(address.sun_path, socketPath.c_str());
+
+		listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listenFd < 0) {
+			throw systemError("Failed to create socket");
+		}
+
+		// Remove the socket left behind by a previous run
+		::unlink(socketPath.c_str());
+
+		if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+			::listen(listenFd, LISTEN_BACKLOG) < 0) {
+			throw systemError("Failed to listen on " + socketPath);
+		}
+	}
+
+	static void installSignalHandlers()
+	{
+		// No SA_RESTART, so that poll() returns when the daemon is stopped
+		struct sigaction action = {};
+		action.sa_handler = handleStopSignal;
+		sigemptyset(&action.sa_mask);
+
+		sigaction(SIGINT, &action, nullptr);
+		sigaction(SIGTERM, &action, nullptr);
+		signal(SIGPIPE, SIG_IGN);
+	}
+
+	// Waits for new connections and for the requests of the open ones. 
+	// Only requests that have fully arrived are read, so an idle or slow 
+	// client never holds up the others. A connection can carry several 
+	// requests one after the other.
+	void eventLoop()
+	{
+		std::vector<pollfd> pollFds;
+
+		while (!stopRequested) {
+			pollFds.clear();
+			pollFds.push_back({ listenFd, POLLIN, 0 });
+			pollFds.push_back({ returnFds[0], POLLIN, 0 });
+			for (const IdleClient& client : idleClients) {
+				pollFds.push_back({ client.fd, POLLIN, 0 });
+			}
+
+			if (::poll(pollFds.data(), pollFds.size(), POLL_INTERVAL_MS) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw systemError("Failed to poll the daemon sockets");
+			}
+
+			Clock::time_point now = Clock::now();
+			std::vector<IdleClient> stillIdle;
+
+			for (size_t i = 0; i < idleClients.size(); i++) {
+				const IdleClient& client = idleClients[i];
+
+				if (pollFds[i + 2].revents != 0) {
+					if (handleRequest(client.fd)) {
+						stillIdle.push_back({ client.fd, now });
+					}
+				}
+				else if (now - client.since > std::chrono::seconds(CLIENT_TIMEOUT_SECONDS)) {
+					::close(client.fd);
+				}
+				else {
+					stillIdle.push_back(client);
+				}
+			}
+			idleClients.swap(stillIdle);
+
+			if (pollFds[1].revents & POLLIN) {
+				receiveReturnedClients();
+			}
+
+			if (pollFds[0].revents & POLLIN) {
+				int clientFd = ::accept(listenFd, nullptr, nullptr);
+
+				if (clientFd >= 0) {
+					// Responses must never block the event loop. A client 
+					// that doesn't read them fills its socket buffer, and 
+					// the next response fails and drops the client.
+					::fcntl(clientFd, F_SETFL, O_NONBLOCK);
+					idleClients.push_back({ clientFd, now });
+				}
+				else if (errno != EINTR && errno != ECONNABORTED) {
+					throw systemError("Failed to accept connection");
+				}
+			}
+		}
+	}
+
+	void receiveReturnedClients()
+	{
+		int fd;
+
+		while (::read(returnFds[0], &fd, sizeof(fd)) == sizeof(fd)) {
+			idleClients.push_back({ fd, Clock::now() });
+		}
+	}
+
+	// Hands a connection back to the event loop for its next request
+	void returnClient(int clientFd)
+	{
+		ssize_t written;
+		do {
+			written = ::write(returnFds[1], &clientFd, sizeof(clientFd));
+		} while (written < 0 && errno == EINTR);
+
+		if (written != sizeof(clientFd)) {
+			::close(clientFd);
+		}
+	}
+
+	// Reads a request that poll() reported. Returns true if the connection 
+	// waits for another request right away, false if it was closed or 
+	// handed to a worker.
+	bool handleRequest(int clientFd)
+	{
+		Clock::time_point received = Clock::now();
+		Byte request[REQUEST_SIZE];
+		int fds[NUM_REQUEST_FDS];
+		size_t numFds = 0;
+
+		// The client closed the connection between requests
+		char peek;
+		if (::recv(clientFd, &peek, 1, MSG_PEEK | MSG_DONTWAIT) <= 0) {
+			::close(clientFd);
+			return false;
+		}
+
+		try {
+			// Clients send a request in a single message, so a request 
+			// that isn't there in full is dropped rather than waited for
+			numFds = receiveRequest(clientFd, request, fds, MSG_DONTWAIT);
+			DaemonOp op = static_cast<DaemonOp>(request[0]);
+
+			if (op == DaemonOp::STATS && numFds == 0) {
+				sendResponse(clientFd, STATUS_OK, formatStats());
+				return true;
+			}
+
+			if ((op != DaemonOp::ZIP && op != DaemonOp::UNZIP) || numFds != NUM_REQUEST_FDS) {
+				throw std::runtime_error("Invalid daemon request.");
+			}
+
+			Job job = { clientFd, fds[0], fds[1], op, decodeOptions(request), received };
+
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push(job);
+			maxQueueDepth = std::max(maxQueueDepth, jobs.size());
+		}
+		catch (std::exception& e) {
+			for (size_t i = 0; i < numFds; i++) {
+				::close(fds[i]);
+			}
+
+			try {
+				sendResponse(clientFd, STATUS_ERROR, e.what());
+			}
+			catch (std::exception&) {
+			}
+			::close(clientFd);
+			return false;
+		}
+
+		jobsAvailable.notify_one();
+		return false;
+	}
+
+	void workerLoop()
+	{
+		for (;;) {
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobsAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (jobs.empty()) {
+					return;
+				}
+
+				job = jobs.front();
+				jobs.pop();
+			}
+
+			inFlight++;
+			process(job);
+			inFlight--;
+		}
+	}
+
+	void process(const Job& job)
+	{
+		Byte status = STATUS_OK;
+		string message;
+
+		try {
+			FdStreamBuf inBuff(job.inFd);
+			FdStreamBuf outBuff(job.outFd);
+			std::istream inStream(&inBuff);
+			std::ostream outStream(&outBuff);
+
+			if (job.op == DaemonOp::ZIP) {
+				SampledStats sampledStats;
+				Compressor::zip(inStream, outStream, job.options, &sampledStats);
+
+				sampledBytes += sampledStats.compressedBytes;
+				sampledFullTableBytes += sampledStats.fullTableBytes;
+			}
+			else {
+				Decompressor::unzip(inStream, outStream, &tableCache);
+			}
+
+			if (!outStream.flush()) {
+				throw std::runtime_error("Failed to write the output file.");
+			}
+		}
+		catch (std::exception& e) {
+			status = STATUS_ERROR;
+			message = e.what();
+			failed++;
+		}
+
+		::close(job.inFd);
+		::close(job.outFd);
+
+		try {
+			sendResponse(job.clientFd, status, message);
+			returnClient(job.clientFd);
+		}
+		catch (std::exception&) {
+			::close(job.clientFd);
+		}
+
+		uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(
+			Clock::now() - job.received).count();
+
+		completed++;
+		totalLatencyUs += latencyUs;
+
+		uint64_t prevMax = maxLatencyUs;
+		while (latencyUs > prevMax && !maxLatencyUs.compare_exchange_weak(prevMax, latencyUs)) {
+		}
+	}
+
+	string formatStats()
+	{
+		size_t queueDepth, maxDepth;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queueDepth = jobs.size();
+			maxDepth = maxQueueDepth;
+		}
+
+		uint64_t numCompleted = completed;
+		uint64_t numSampledBytes = sampledBytes;
+		uint64_t numFullTableBytes = sampledFullTableBytes;
+
+		std::ostringstream stats;
+		stats << "workers " << numWorkers << "\n"
+			<< "cpu_path " << Kernels::getCpuPathName(Kernels::getCpuPath()) << "\n"
+			<< "queue_depth " << queueDepth << "\n"
+			<< "max_queue_depth " << maxDepth << "\n"
+			<< "in_flight " << inFlight << "\n"
+			<< "completed " << numCompleted << "\n"
+			<< "failed " << failed << "\n"
+			<< "avg_latency_us " << (numCompleted > 0 ? totalLatencyUs / numCompleted : 0) << "\n"
+			<< "max_latency_us " << maxLatencyUs << "\n"
+			<< "table_cache_hits " << tableCache.getHits() << "\n"
+			<< "table_cache_misses " << tableCache.getMisses() << "\n"
+			<< "sampled_bytes " << numSampledBytes << "\n"
+			<< "sampled_full_table_bytes " << numFullTableBytes << "\n"
+			<< "sampled_penalty_pct " << std::fixed << std::setprecision(2) 
+			<< (numFullTableBytes > 0 ? (double(numSampledBytes) / numFullTableBytes - 1) * 100 : 0.0) << "\n";
+
+		return stats.str();
+	}
+};
+
+int connectToDaemon(const std::string& socketPath)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Socket path is too long: " + socketPath);
+	}
+	std::strcpy(address.sun_path, socketPath.c_str());
+
+	int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		throw systemError("Failed to create socket");
+	}
+
+	if (::connect(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+		::close(sock);
+		throw systemError("Failed to connect to the daemon at " + socketPath);
+	}
+
+	return sock;
+}
+
+void requestFileOperation(const std::string& socketPath, DaemonOp op,
+	const std::string& inFilePath, const std::string& outFilePath,
+	const CompressionOptions& options)
+{
+	int fds[NUM_REQUEST_FDS];
+
+	fds[0] = ::open(inFilePath.c_str(), O_RDONLY);
+	if (fds[0] < 0) {
+		throw systemError("Failed to open file: " + inFilePath);
+	}
+
+	fds[1] = ::open(outFilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fds[1] < 0) {
+		::close(fds[0]);
+		throw systemError("Failed to open file: " + outFilePath);
+	}
+
+	Byte request[REQUEST_SIZE];
+	encodeRequest(request, op, options);
+
+	int sock = -1;
+
+	try {
+		sock = connectToDaemon(socketPath);
+		sendRequest(sock, request, fds, NUM_REQUEST_FDS);
+
+		// The daemon holds its own copies of the descriptors now
+		::close(fds[0]);
+		::close(fds[1]);
+		fds[0] = fds[1] = -1;
+
+		receiveResponse(sock);
+	}
+	catch (std::exception&) {
+		for (int fd : fds) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+		if (sock >= 0) {
+			::close(sock);
+		}
+		throw;
+	}
+
+	::close(sock);
+}
+}
+
+int runDaemon(const std::string& socketPath, size_t numWorkers)
+{
+	CompressionDaemon daemon(socketPath, numWorkers);
+	return daemon.run();
+}
+
+void daemonZip(const std::string& socketPath, const std::string& inFilePath,
+	const std::string& outFilePath, const CompressionOptions& options)
+{
+	requestFileOperation(socketPath, DaemonOp::ZIP, inFilePath, outFilePath, options);
+}
+
+void daemonUnzip(const std::string& socketPath, const std::string& inFilePath,
+	const std::string& outFilePath)
+{
+	requestFileOperation(socketPath, DaemonOp::UNZIP, inFilePath, outFilePath, {});
+}
+
+std::string daemonStats(const std::string& socketPath)
+{
+	Byte request[REQUEST_SIZE];
+	encodeRequest(request, DaemonOp::STATS, {});
+
+	int sock = connectToDaemon(socketPath);
+
+	try {
+		sendRequest(sock, request, nullptr, 0);
+		std::string stats = receiveResponse(sock);
+		::close(sock);
+		return stats;
+	}
+	catch (std::exception&) {
+		::close(sock);
+		throw;
+	}
+}
+
+#else
+
+static const std::string DAEMON_UNSUPPORTED = "The daemon mode requires Unix domain sockets.";
+
+int runDaemon(const std::string&, size_t)
+{
+	throw std::runtime_error(DAEMON_UNSUPPORTED);
+}
+
+void daemonZip(const std::string&, const std::string&, const std::string&, const CompressionOptions&)
+{
+	throw std::runtime_error(DAEMON_UNSUPPORTED);
+}
+
+void daemonUnzip(const std::string&, const std::string&, const std::string&)
+{
+	throw std::runtime_error(DAEMON_UNSUPPORTED);
+}
+
+std::string daemonStats(const std::string&)
+{
+	throw std::runtime_error(DAEMON_UNSUPPORTED);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "huffman.hpp"
+
+// Runs the compression daemon on a Unix domain socket until it is killed.
+// Requests are served by a pool of `numWorkers` threads (0 picks one per
+// hardware thread), which share a cache of decoding tables.
+int runDaemon(const std::string& socketPath, size_t numWorkers = 0);
+
+// Asks the daemon to compress or decompress a file. The files are opened
+// here and their descriptors are passed to the daemon, which reads and
+// writes them directly. Throws if the daemon reports an error.
+void daemonZip(const std::string& socketPath, const std::string& inFilePath,
+	const std::string& outFilePath, const CompressionOptions& options);
+void daemonUnzip(const std::string& socketPath, const std::string& inFilePath,
+	const std::string& outFilePath);
+
+// Returns the daemon metrics, one "name value" pair per line.
+std::string daemonStats(const std::string& socketPath);
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "canonical-code.hpp"
+#include "fse.hpp"
+
+// Ready-to-use decoding tables of Huffman and FSE blocks
+struct HuffDecodeTable
+{
+	std::vector<DecodeEntry> entries;
+	size_t tableLog;
+};
+
+struct FseDecodeTable
+{
+	std::vector<FseDecodeEntry> entries;
+	size_t tableLog;
+};
+
+// Builds the decoding tables of the serialized block tables
+namespace DecodeTables
+{
+inline std::shared_ptr<const HuffDecodeTable> buildHuffman(const std::vector<Byte>& tableBytes)
+{
+	BitReader reader(tableBytes.data(), tableBytes.size());
+	CanonicalCode code = CanonicalCode::readTable(reader);
+
+	return std::make_shared<const HuffDecodeTable>(
+		HuffDecodeTable{ code.buildDecodeTable(), code.getMaxLength() });
+}
+
+inline std::shared_ptr<const FseDecodeTable> buildFse(const std::vector<Byte>& tableBytes)
+{
+	BitReader reader(tableBytes.data(), tableBytes.size());
+	FseTable table = FseTable::readTable(reader);
+
+	return std::make_shared<const FseDecodeTable>(
+		FseDecodeTable{ table.buildDecodeTable(), table.getTableLog() });
+}
+}
+
+// Thread-safe LRU cache of decoding tables, keyed by the hash of the
+// serialized table. Long-running processes that decompress many small
+// files coded with similar data skip rebuilding the same tables.
+class DecodeTableCache
+{
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 256;
+
+	DecodeTableCache(size_t capacity = DEFAULT_CAPACITY)
+		: huffTables(capacity), fseTables(capacity)
+	{
+	}
+
+	std::shared_ptr<const HuffDecodeTable> getHuffman(const std::vector<Byte>& tableBytes)
+	{
+		return huffTables.get(tableBytes, DecodeTables::buildHuffman, hits, misses);
+	}
+
+	std::shared_ptr<const FseDecodeTable> getFse(const std::vector<Byte>& tableBytes)
+	{
+		return fseTables.get(tableBytes, DecodeTables::buildFse, hits, misses);
+	}
+
+	uint64_t getHits() const
+	{
+		return hits;
+	}
+
+	uint64_t getMisses() const
+	{
+		return misses;
+	}
+
+private:
+	template <typename Table>
+	class LruCache
+	{
+	private:
+		// Alias declarations
+		using TablePtr = std::shared_ptr<const Table>;
+
+	public:
+		LruCache(size_t capacity)
+			: capacity(capacity)
+		{
+		}
+
+		template <typename Builder>
+		TablePtr get(const std::vector<Byte>& tableBytes, Builder build,
+			std::atomic<uint64_t>& hits, std::atomic<uint64_t>& misses)
+		{
+			uint64_t key = hashBytes(tableBytes);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				auto iter = index.find(key);
+
+				// Tables are compared in full, so a hash collision is only a miss
+				if (iter != index.end() && iter->second->tableBytes == tableBytes) {
+					entries.splice(entries.begin(), entries, iter->second);
+					hits++;
+					return iter->second->table;
+				}
+			}
+
+			// Build outside of the lock, other workers keep decoding
+			misses++;
+			TablePtr table = build(tableBytes);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto iter = index.find(key);
+
+			if (iter != index.end()) {
+				entries.erase(iter->second);
+				index.erase(iter);
+			}
+
+			entries.push_front({ key, tableBytes, table });
+			index[key] = entries.begin();
+
+			if (entries.size() > capacity) {
+				index.erase(entries.back().key);
+				entries.pop_back();
+			}
+
+			return table;
+		}
+
+	private:
+		struct Entry
+		{
+			uint64_t key;
+			std::vector<Byte> tableBytes;
+			TablePtr table;
+		};
+
+		size_t capacity;
+		std::mutex mutex;
+		std::list<Entry> entries;
+		std::unordered_map<uint64_t, typename std::list<Entry>::iterator> index;
+
+		// 64-bit FNV-1a
+		static uint64_t hashBytes(const std::vector<Byte>& bytes)
+		{
+			uint64_t hash = 0xCBF29CE484222325ull;
+
+			for (Byte byte : bytes) {
+				hash ^= byte;
+				hash *= 0x100000001B3ull;
+			}
+
+			return hash;
+		}
+	};
+
+	LruCache<HuffDecodeTable> huffTables;
+	LruCache<FseDecodeTable> fseTables;
+	std::atomic<uint64_t> hits{ 0 };
+	std::atomic<uint64_t> misses{ 0 };
+};
\ No newline at end of file
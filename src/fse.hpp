@@ -0,0 +1,320 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+#include "bit-stream.hpp"
+
+// Entry of the tANS decoding table: the symbol emitted in this state,
+// the number of bits to read and the base of the next state.
+struct FseDecodeEntry
+{
+	uint16_t newState;
+	Byte symbol;
+	Byte numBits;
+};
+
+// Normalized symbol distribution for table-based asymmetric numeral
+// systems (tANS, as in Finite State Entropy). Each byte gets a share of
+// the 2^tableLog states proportional to its frequency, which lets it
+// be coded with a fractional number of bits.
+class FseTable
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+	using NormCountTable = std::array<uint16_t, 256>;
+
+public:
+	static constexpr size_t MIN_TABLE_LOG = 5;
+	static constexpr size_t MAX_TABLE_LOG = 12;
+	static constexpr size_t DEFAULT_TABLE_LOG = 11;
+
+	FseTable()
+	{
+	}
+
+	FseTable(const ByteFreqTable& byteFreqs, size_t maxTableLog = DEFAULT_TABLE_LOG)
+	{
+		uint64_t total = 0;
+		size_t numSymbols = 0;
+
+		for (uint64_t freq : byteFreqs) {
+			total += freq;
+			numSymbols += (freq > 0) ? 1 : 0;
+		}
+
+		if (total == 0) {
+			throw std::invalid_argument("Cannot build a FSE table for an empty input.");
+		}
+
+		// Small inputs don't need a large table, but every present symbol
+		// needs at least one state
+		tableLog = std::clamp(maxTableLog, MIN_TABLE_LOG, MAX_TABLE_LOG);
+
+		while (tableLog > MIN_TABLE_LOG && (1ull << (tableLog - 1)) >= total) {
+			tableLog--;
+		}
+
+		while ((size_t(1) << tableLog) < numSymbols) {
+			tableLog++;
+		}
+
+		normalize(byteFreqs, total);
+	}
+
+	size_t getTableLog() const
+	{
+		return tableLog;
+	}
+
+	const NormCountTable& getNormCounts() const
+	{
+		return normCounts;
+	}
+
+	// Estimated number of bits needed to encode the given histogram.
+	uint64_t getEncodedBits(const ByteFreqTable& byteFreqs) const
+	{
+		double total = static_cast<double>(tableLog);
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			if (byteFreqs[byte] > 0) {
+				total += byteFreqs[byte] * (tableLog - std::log2(normCounts[byte]));
+			}
+		}
+
+		return static_cast<uint64_t>(std::ceil(total));
+	}
+
+	// Writes the table log followed by the normalized counts, each as an
+	// order-0 Exp-Golomb code, so absent and rare bytes take few bits.
+	void writeTable(BitWriter& writer) const
+	{
+		size_t lastSymbol = 255;
+		while (lastSymbol > 0 && normCounts[lastSymbol] == 0) {
+			lastSymbol--;
+		}
+
+		writer.writeBits(static_cast<uint32_t>(tableLog), 4);
+		writer.writeBits(static_cast<uint32_t>(lastSymbol), 8);
+
+		for (size_t byte = 0; byte <= lastSymbol; byte++) {
+			uint32_t value = normCounts[byte] + 1u;
+			size_t numBits = std::bit_width(value);
+
+			writer.writeBits(0, numBits - 1);
+			writer.writeBits(value, numBits);
+		}
+	}
+
+	static FseTable readTable(BitReader& reader)
+	{
+		FseTable table;
+		table.tableLog = reader.readBits(4);
+
+		if (table.tableLog < MIN_TABLE_LOG || table.tableLog > MAX_TABLE_LOG) {
+			throw std::runtime_error("Corrupted FSE table.");
+		}
+
+		size_t lastSymbol = reader.readBits(8);
+		uint64_t total = 0;
+
+		for (size_t byte = 0; byte <= lastSymbol; byte++) {
+			size_t numZeros = 0;
+			while (reader.readBits(1) == 0) {
+				if (++numZeros > table.tableLog) {
+					throw std::runtime_error("Corrupted FSE table.");
+				}
+			}
+
+			uint32_t value = (1u << numZeros) | reader.readBits(numZeros);
+			table.normCounts[byte] = static_cast<uint16_t>(value - 1);
+			total += value - 1;
+		}
+
+		if (total != (1ull << table.tableLog)) {
+			throw std::runtime_error("Corrupted FSE table.");
+		}
+
+		return table;
+	}
+
+	// Order in which the states are assigned to symbols. Spreading each
+	// symbol across the table keeps the state transitions well mixed.
+	std::vector<Byte> spreadSymbols() const
+	{
+		size_t tableSize = size_t(1) << tableLog;
+		size_t mask = tableSize - 1;
+		size_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+
+		std::vector<Byte> stateSymbols(tableSize);
+		size_t pos = 0;
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			for (size_t i = 0; i < normCounts[byte]; i++) {
+				stateSymbols[pos] = static_cast<Byte>(byte);
+				pos = (pos + step) & mask;
+			}
+		}
+
+		return stateSymbols;
+	}
+
+	std::vector<FseDecodeEntry> buildDecodeTable() const
+	{
+		size_t tableSize = size_t(1) << tableLog;
+		std::vector<Byte> stateSymbols = spreadSymbols();
+		std::vector<FseDecodeEntry> table(tableSize);
+		NormCountTable nextStates = normCounts;
+
+		for (size_t state = 0; state < tableSize; state++) {
+			Byte byte = stateSymbols[state];
+			uint32_t nextState = nextStates[byte]++;
+			size_t numBits = tableLog - (std::bit_width(nextState) - 1);
+
+			table[state].symbol = byte;
+			table[state].numBits = static_cast<Byte>(numBits);
+			table[state].newState = static_cast<uint16_t>((nextState << numBits) - tableSize);
+		}
+
+		return table;
+	}
+
+private:
+	size_t tableLog = 0;
+	NormCountTable normCounts{ 0 };
+
+	void normalize(const ByteFreqTable& byteFreqs, uint64_t total)
+	{
+		int64_t tableSize = int64_t(1) << tableLog;
+		int64_t sum = 0;
+		size_t largest = 0;
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			if (byteFreqs[byte] == 0) {
+				continue;
+			}
+
+			uint64_t scaled = byteFreqs[byte] * static_cast<uint64_t>(tableSize) / total;
+			normCounts[byte] = static_cast<uint16_t>(std::max<uint64_t>(scaled, 1));
+			sum += normCounts[byte];
+
+			if (byteFreqs[byte] > byteFreqs[largest]) {
+				largest = byte;
+			}
+		}
+
+		// Rounding leftovers go to the most frequent byte, where they cost
+		// the least; an excess is taken from the largest counts
+		if (sum < tableSize) {
+			normCounts[largest] += static_cast<uint16_t>(tableSize - sum);
+		}
+
+		while (sum > tableSize) {
+			size_t maxByte = 0;
+			for (size_t byte = 1; byte < 256; byte++) {
+				if (normCounts[byte] > normCounts[maxByte]) {
+					maxByte = byte;
+				}
+			}
+
+			normCounts[maxByte]--;
+			sum--;
+		}
+	}
+};
+
+class FseEncoder
+{
+public:
+	// Symbols are encoded from last to first, as tANS decodes in the
+	// reverse order of encoding. The emitted bits are buffered and then
+	// written backwards, so the decoder reads the stream front to back.
+	static void encode(const Byte* inBuff, size_t inBuffSize, const FseTable& fseTable,
+		BitWriter& writer)
+	{
+		size_t tableLog = fseTable.getTableLog();
+		uint32_t tableSize = uint32_t(1) << tableLog;
+		const std::array<uint16_t, 256>& normCounts = fseTable.getNormCounts();
+
+		// Encoding states of each symbol, sorted by decoding state
+		std::vector<Byte> stateSymbols = fseTable.spreadSymbols();
+		std::vector<uint16_t> stateTable(tableSize);
+		std::array<uint32_t, 257> cumulCounts{ 0 };
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			cumulCounts[byte + 1] = cumulCounts[byte] + normCounts[byte];
+		}
+
+		std::array<uint32_t, 257> nextPos = cumulCounts;
+		for (uint32_t state = 0; state < tableSize; state++) {
+			stateTable[nextPos[stateSymbols[state]]++] = static_cast<uint16_t>(tableSize + state);
+		}
+
+		// Per-symbol constants that turn a state into the number of bits
+		// to flush and the position of the next state
+		std::array<SymbolTransform, 256> transforms{};
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			uint32_t count = normCounts[byte];
+
+			if (count == 0) {
+				continue;
+			}
+
+			uint32_t maxBitsOut = static_cast<uint32_t>(tableLog) -
+				((count == 1) ? 0 : static_cast<uint32_t>(std::bit_width(count - 1) - 1));
+			uint32_t minStatePlus = count << maxBitsOut;
+
+			transforms[byte].deltaNumBits = (maxBitsOut << 16) - minStatePlus;
+			transforms[byte].deltaFindState = static_cast<int32_t>(cumulCounts[byte]) -
+				static_cast<int32_t>(count);
+		}
+
+		std::vector<uint32_t> chunks(inBuffSize);
+		uint32_t state = tableSize;
+
+		for (size_t i = inBuffSize; i-- > 0; ) {
+			const SymbolTransform& transform = transforms[inBuff[i]];
+			uint32_t numBits = (state + transform.deltaNumBits) >> 16;
+
+			chunks[i] = (numBits << 16) | (state & ((1u << numBits) - 1));
+			state = stateTable[(state >> numBits) + transform.deltaFindState];
+		}
+
+		writer.writeBits(state - tableSize, tableLog);
+
+		for (uint32_t chunk : chunks) {
+			writer.writeBits(chunk & 0xFFFF, chunk >> 16);
+		}
+	}
+
+private:
+	struct SymbolTransform
+	{
+		uint32_t deltaNumBits;
+		int32_t deltaFindState;
+	};
+};
+
+class FseDecoder
+{
+public:
+	static void decode(BitReader& reader, const std::vector<FseDecodeEntry>& decodeTable,
+		size_t tableLog, Byte* outBuff, size_t outBuffSize)
+	{
+		uint32_t state = reader.readBits(tableLog);
+
+		for (size_t i = 0; i < outBuffSize; i++) {
+			const FseDecodeEntry& entry = decodeTable[state];
+
+			outBuff[i] = entry.symbol;
+			state = entry.newState + reader.readBits(entry.numBits);
+		}
+	}
+};
\ No newline at end of file
@@ -26,11 +26,11 @@ class HuffEncoder
 private:
 	// Alias declarations
 	using string = std::string;
-	using fstream = std::fstream;
+	using istream = std::istream;
 	using ByteFreqTable = std::array<uint64_t, 256>;
 
 public:
-	HuffEncoder(fstream& inFile) 
+	HuffEncoder(istream& inFile) 
 	{
 		ByteFreqTable byteFreqs = countFrequencies(inFile);
 
@@ -63,7 +63,7 @@ private:
 	HuffDict huffDict;
 
 	// Returns the frequency of each distinct byte in the given file.
-	ByteFreqTable countFrequencies(fstream& inFile) 
+	ByteFreqTable countFrequencies(istream& inFile) 
 	{
 		ByteFreqTable byteFreqs{ 0 };
 		Byte byte;
@@ -3,9 +3,34 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cmath>
+#include <filesystem>
 
 #include "scoped-handler.hpp"
 #include "huffman-encoder.hpp"
+#include "adaptive-huffman.hpp"
+#include "block-codec.hpp"
+#include "sampled-table.hpp"
+#include "compression-level.hpp"
+#include "container-format.hpp"
+
+enum class CompressionMode
+{
+	// Frequency table stored in the file, followed by the bitstream
+	STATIC,
+	// Single read of the input; the model is rebuilt on the fly
+	ADAPTIVE,
+	// Self-contained blocks, each with its own table and entropy coder
+	BLOCKS,
+	// Single read of the input; blocks share a table built from a sample
+	SAMPLED
+};
+
+struct CompressionOptions
+{
+	CompressionMode mode = CompressionMode::STATIC;
+	BlockSettings blockSettings = CompressionLevel::getSettings(CompressionLevel::DEFAULT_LEVEL);
+};
 
 class Compressor 
 {
@@ -13,17 +38,51 @@ private:
 	// Alias declarations
 	using string = std::string;
 	using fstream = std::fstream;
+	using istream = std::istream;
+	using ostream = std::ostream;
 	using ios = std::ios;
+	using ByteFreqTable = std::array<uint64_t, 256>;
 
 public:
-	static void zip(const string& inFilePath, const string& outFilePath) 
+	static void zip(const string& inFilePath, const string& outFilePath, 
+		const CompressionOptions& options = {}, SampledStats* stats = nullptr) 
 	{
-		RAIIFileHandler scopedInFile(inFilePath, ios::binary | ios::in);
+		// Block modes read whole blocks at once, so their file buffers
+		// follow the block size
+		size_t ioBufferSize = (options.mode == CompressionMode::BLOCKS || 
+			options.mode == CompressionMode::SAMPLED) ? options.blockSettings.blockSize : BUFFER_SIZE;
+
+		RAIIFileHandler scopedInFile(inFilePath, ios::binary | ios::in, ioBufferSize);
 		fstream& inFile = scopedInFile.get();
 
-		RAIIFileHandler scopedOutFile(outFilePath, ios::binary | ios::out);
+		RAIIFileHandler scopedOutFile(outFilePath, ios::binary | ios::out, ioBufferSize);
 		fstream& outFile = scopedOutFile.get();
 
+		zip(inFile, outFile, options, stats);
+	}
+
+	// Compresses between streams. The input has to be seekable in the 
+	// static mode and the output in every mode, as the header is patched
+	// once the data is written. The sampled mode reports the cost of its
+	// table in `stats` when one is given.
+	static void zip(istream& inFile, ostream& outFile, const CompressionOptions& options = {},
+		SampledStats* stats = nullptr)
+	{
+		if (options.mode == CompressionMode::ADAPTIVE) {
+			compressAdaptive(inFile, outFile);
+			return;
+		}
+
+		if (options.mode == CompressionMode::BLOCKS) {
+			compressBlocks(inFile, outFile, options.blockSettings);
+			return;
+		}
+
+		if (options.mode == CompressionMode::SAMPLED) {
+			compressSampled(inFile, outFile, options.blockSettings, stats);
+			return;
+		}
+
 		HuffEncoder encoder(inFile);
 
 		HuffTree huffTree = encoder.getHuffTree();
@@ -34,6 +93,69 @@ public:
 		compress(inFile, outFile, huffDict);
 	}
 
+	// Compresses the input into new blocks at the end of an existing 
+	// block mode file, chained to its current index, so only the new data 
+	// is read and compressed. A missing output file is simply created. 
+	// The output stays locked for the whole append, so concurrent appends 
+	// to the same file run one after the other.
+	static void append(const string& inFilePath, const string& outFilePath, 
+		const BlockSettings& settings)
+	{
+		RAIIFileLock scopedLock(outFilePath);
+
+		// The lock creates the file if it was missing
+		if (!std::filesystem::exists(outFilePath) || std::filesystem::file_size(outFilePath) == 0) {
+			zip(inFilePath, outFilePath, { CompressionMode::BLOCKS, settings });
+			return;
+		}
+
+		RAIIFileHandler scopedInFile(inFilePath, ios::binary | ios::in, settings.blockSize);
+		fstream& inFile = scopedInFile.get();
+
+		RAIIFileHandler scopedOutFile(outFilePath, ios::binary | ios::in | ios::out, 
+			settings.blockSize);
+		fstream& outFile = scopedOutFile.get();
+
+		ContainerFormat::Mode mode;
+
+		if (!ContainerFormat::readHeader(outFile, mode) || mode != ContainerFormat::Mode::BLOCKS) {
+			throw std::runtime_error("Only files compressed in block mode can be appended to.");
+		}
+
+		uint64_t indexOffset = ContainerFormat::readUInt(outFile, 8);
+
+		outFile.seekg(indexOffset, ios::beg);
+		if (ContainerFormat::readUInt(outFile, 1) != static_cast<Byte>(BlockType::INDEX)) {
+			throw std::runtime_error("Corrupted block index.");
+		}
+
+		ContainerFormat::readUInt(outFile, 8);
+		uint64_t numEntries = ContainerFormat::readUInt(outFile, 4);
+
+		// The new blocks go right after the current index, over anything 
+		// an interrupted append may have left there
+		uint64_t endOffset = indexOffset + BlockEncoder::INDEX_HEADER_SIZE + 
+			numEntries * BlockEncoder::INDEX_ENTRY_SIZE;
+
+		outFile.seekp(endOffset, ios::beg);
+
+		BlockEncoder encoder(outFile, settings, endOffset);
+		encodeBlocks(inFile, encoder, settings.blockSize);
+
+		uint64_t newIndexOffset = encoder.finish(indexOffset);
+		outFile.flush();
+
+		// Commit the append. Until the header points to the new index, 
+		// readers keep seeing the file as it was before.
+		outFile.seekp(ContainerFormat::INDEX_OFFSET_POS, ios::beg);
+		ContainerFormat::writeUInt(outFile, newIndexOffset, 8);
+		outFile.flush();
+
+		if (!outFile) {
+			throw std::runtime_error("Failed to write file: " + outFilePath);
+		}
+	}
+
 private:
 	static constexpr size_t BUFFER_SIZE = 1024;
 
@@ -55,7 +177,7 @@ private:
 
 	// Write the metadata on the beginning of the compressed file.
 	// It contains information required to decompress the original file content.
-	static void writeMetadata(fstream& outputFile, const HuffTree& huffTree)
+	static void writeMetadata(ostream& outputFile, const HuffTree& huffTree)
 	{
 		std::vector<HuffTreeNodePtr> leaves = huffTree.getLeaves();
 
@@ -143,7 +265,7 @@ private:
 		}
 	}
 
-	static void writeVlcToFile(HuffVLC& vlc, fstream& file) 
+	static void writeVlcToFile(HuffVLC& vlc, ostream& file) 
 	{
 		vlc.numBits %= 8;
 
@@ -163,7 +285,7 @@ private:
 		}
 	}
 
-	static void compress(fstream& inFile, fstream& outFile, const HuffDict& huffDict)
+	static void compress(istream& inFile, ostream& outFile, const HuffDict& huffDict)
 	{
 		Byte inBuff[BUFFER_SIZE];
 		HuffVLC vlcBuff;
@@ -186,6 +308,153 @@ private:
 			outFile.write(reinterpret_cast<char*>(&vlcBuff.code[0]), 1);
 		}
 	}
+
+	// One-pass compression: the input is read once and the number of 
+	// bytes is patched into the header after the bitstream is written.
+	static void compressAdaptive(istream& inFile, ostream& outFile)
+	{
+		ContainerFormat::writeHeader(outFile, ContainerFormat::Mode::ADAPTIVE);
+
+		std::streampos sizePos = outFile.tellp();
+		ContainerFormat::writeUInt(outFile, 0, 8);
+
+		Byte inBuff[BUFFER_SIZE];
+		uint64_t totalBytes = 0;
+
+		BitWriter writer(outFile);
+		AdaptiveHuffEncoder encoder(writer);
+
+		inFile.read(reinterpret_cast<char*>(inBuff), BUFFER_SIZE);
+		std::streamsize bytesRead;
+
+		while ((bytesRead = inFile.gcount()) > 0) {
+			encoder.encode(inBuff, bytesRead);
+			totalBytes += bytesRead;
+
+			inFile.read(reinterpret_cast<char*>(inBuff), BUFFER_SIZE);
+		}
+
+		writer.flush();
+
+		outFile.seekp(sizePos);
+		ContainerFormat::writeUInt(outFile, totalBytes, 8);
+	}
+
+	static void compressBlocks(istream& inFile, ostream& outFile, const BlockSettings& settings)
+	{
+		ContainerFormat::writeHeader(outFile, ContainerFormat::Mode::BLOCKS);
+		ContainerFormat::writeUInt(outFile, 0, 8);
+
+		BlockEncoder encoder(outFile, settings);
+		encodeBlocks(inFile, encoder, settings.blockSize);
+
+		uint64_t indexOffset = encoder.finish();
+
+		outFile.seekp(ContainerFormat::INDEX_OFFSET_POS, ios::beg);
+		ContainerFormat::writeUInt(outFile, indexOffset, 8);
+	}
+
+	// Single streaming read: the Huffman table comes from a strided sample
+	// of the input (or from its first block, if the input can't seek or 
+	// fits in a block) and is shared by all the blocks. A block the table
+	// codes much worse than the sample escapes to a table of its own. The
+	// output is a regular block mode file.
+	static void compressSampled(istream& inFile, ostream& outFile, const BlockSettings& settings,
+		SampledStats* stats)
+	{
+		ContainerFormat::writeHeader(outFile, ContainerFormat::Mode::BLOCKS);
+		ContainerFormat::writeUInt(outFile, 0, 8);
+
+		BlockEncoder encoder(outFile, settings);
+		ByteFreqTable sampleFreqs{ 0 };
+		ByteFreqTable totalFreqs{ 0 };
+		bool hasSample = SampledTable::readStridedSample(inFile, settings.blockSize, sampleFreqs);
+
+		CanonicalCode code;
+		double expectedBits = 0;
+		SampledStats sampledStats;
+		uint64_t numBlocks = 0;
+
+		std::vector<Byte> block(settings.blockSize);
+		inFile.read(reinterpret_cast<char*>(block.data()), block.size());
+		std::streamsize bytesRead;
+
+		while ((bytesRead = inFile.gcount()) > 0) {
+			ByteFreqTable blockFreqs{ 0 };
+			Kernels::countBytes(block.data(), bytesRead, blockFreqs);
+
+			if (numBlocks == 0) {
+				const ByteFreqTable& freqs = hasSample ? sampleFreqs : blockFreqs;
+
+				code = SampledTable::build(freqs, settings.maxCodeLength);
+				expectedBits = SampledTable::getBitsPerByte(code, freqs);
+			}
+
+			// An escaping block gets a table of its own, and the blocks 
+			// after it go back to the shared one
+			if (numBlocks > 0 && 
+				SampledTable::getBitsPerByte(code, blockFreqs) > expectedBits * (1 + SampledTable::ESCAPE_TOLERANCE)) {
+				encoder.encodeBlock(block.data(), bytesRead, 
+					SampledTable::build(blockFreqs, settings.maxCodeLength), blockFreqs);
+				sampledStats.numEscapes++;
+			}
+			else {
+				encoder.encodeBlock(block.data(), bytesRead, code, blockFreqs);
+			}
+
+			for (size_t byte = 0; byte < 256; byte++) {
+				totalFreqs[byte] += blockFreqs[byte];
+			}
+			sampledStats.inputBytes += bytesRead;
+			numBlocks++;
+
+			inFile.read(reinterpret_cast<char*>(block.data()), block.size());
+		}
+
+		uint64_t indexOffset = encoder.finish();
+
+		outFile.seekp(ContainerFormat::INDEX_OFFSET_POS, ios::beg);
+		ContainerFormat::writeUInt(outFile, indexOffset, 8);
+
+		if (stats != nullptr) {
+			sampledStats.compressedBytes = encoder.getOffset() - ContainerFormat::BLOCKS_HEADER_SIZE;
+			sampledStats.fullTableBytes = getFullTableSize(totalFreqs, settings.maxCodeLength, 
+				sampledStats.inputBytes, numBlocks);
+			*stats = sampledStats;
+		}
+	}
+
+	// Estimated size of the blocks and index of the sampled mode if they
+	// were coded with a single table built from the whole histogram
+	static uint64_t getFullTableSize(const ByteFreqTable& totalFreqs, size_t maxCodeLength, 
+		uint64_t inputBytes, uint64_t numBlocks)
+	{
+		CanonicalCode fullCode(totalFreqs, maxCodeLength);
+		std::vector<Byte> table;
+
+		BitWriter tableWriter(table);
+		fullCode.writeTable(tableWriter);
+		tableWriter.flush();
+
+		uint64_t payloadSize = std::min<uint64_t>(
+			(fullCode.getEncodedBits(totalFreqs) + 7) / 8 + table.size(), inputBytes);
+
+		return numBlocks * (BlockEncoder::BLOCK_HEADER_SIZE + BlockEncoder::INDEX_ENTRY_SIZE) + 
+			BlockEncoder::INDEX_HEADER_SIZE + payloadSize;
+	}
+
+	static void encodeBlocks(istream& inFile, BlockEncoder& encoder, size_t blockSize)
+	{
+		std::vector<Byte> block(blockSize);
+
+		inFile.read(reinterpret_cast<char*>(block.data()), block.size());
+		std::streamsize bytesRead;
+
+		while ((bytesRead = inFile.gcount()) > 0) {
+			encoder.encodeBlock(block.data(), bytesRead);
+			inFile.read(reinterpret_cast<char*>(block.data()), block.size());
+		}
+	}
 };
 
 class Decompressor 
@@ -194,18 +463,40 @@ private:
 	// Alias declarations
 	using string = std::string;
 	using fstream = std::fstream;
+	using istream = std::istream;
+	using ostream = std::ostream;
 	using ios = std::ios;
 	using ByteFreqTable = std::array<uint64_t, 256>;
 
 public:
 	static void unzip(const string& inFilePath, const string& outFilePath) 
 	{
-		RAIIFileHandler scopedInFile(inFilePath, ios::binary | ios::in);
+		RAIIFileHandler scopedInFile(inFilePath, ios::binary | ios::in, IO_BUFFER_SIZE);
 		fstream& inFile = scopedInFile.get();
 
-		RAIIFileHandler scopedOutFile(outFilePath, ios::binary | ios::out);
+		RAIIFileHandler scopedOutFile(outFilePath, ios::binary | ios::out, IO_BUFFER_SIZE);
 		fstream& outFile = scopedOutFile.get();
 
+		unzip(inFile, outFile);
+	}
+
+	// Decompresses between streams. The input has to be seekable, as the
+	// format is detected by looking at its first bytes. Block mode 
+	// decoding tables are taken from `cache` when one is given.
+	static void unzip(istream& inFile, ostream& outFile, DecodeTableCache* cache = nullptr)
+	{
+		ContainerFormat::Mode mode;
+
+		if (ContainerFormat::readHeader(inFile, mode)) {
+			if (mode == ContainerFormat::Mode::ADAPTIVE) {
+				decompressAdaptive(inFile, outFile);
+			}
+			else {
+				decompressBlocks(inFile, outFile, cache);
+			}
+			return;
+		}
+
 		ByteFreqTable byteFreqs = countFrequencies(inFile);
 
 		HuffEncoder encoder(byteFreqs);
@@ -216,12 +507,13 @@ public:
 
 private:
 	static constexpr size_t BUFFER_SIZE = 1024;
+	static constexpr size_t IO_BUFFER_SIZE = size_t(1) << 16;
 
 	Decompressor() 
 	{
 	}
 
-	static uint8_t* readMetadata(fstream& inFile) {
+	static uint8_t* readMetadata(istream& inFile) {
 		uint8_t distinctBytes, minBytesFreq;
 
 		inFile.read(reinterpret_cast<char*>(&distinctBytes), 1);
@@ -238,7 +530,7 @@ private:
 		return metadata;
 	}
 
-	static ByteFreqTable countFrequencies(fstream& inFile)
+	static ByteFreqTable countFrequencies(istream& inFile)
 	{
 		uint8_t* metadata = readMetadata(inFile);
 
@@ -267,7 +559,7 @@ private:
 		return byteFreqs;
 	}
 
-	static void decompress(fstream& inFile, fstream& outFile, const HuffTree& huffTree) 
+	static void decompress(istream& inFile, ostream& outFile, const HuffTree& huffTree) 
 	{
 		HuffTreeNodePtr nodePtr = huffTree.getRoot();
 		size_t bytesToDecode = nodePtr->getFrequency();
@@ -303,4 +595,30 @@ private:
 			while (currentBit != 0);
 		}
 	}
+	static void decompressAdaptive(istream& inFile, ostream& outFile)
+	{
+		uint64_t bytesToDecode = ContainerFormat::readUInt(inFile, 8);
+		Byte outBuff[BUFFER_SIZE];
+
+		BitReader reader(inFile);
+		AdaptiveHuffDecoder decoder(reader);
+
+		while (bytesToDecode > 0) {
+			size_t chunkSize = static_cast<size_t>(std::min<uint64_t>(bytesToDecode, BUFFER_SIZE));
+
+			decoder.decode(outBuff, chunkSize);
+			outFile.write(reinterpret_cast<char*>(outBuff), chunkSize);
+
+			bytesToDecode -= chunkSize;
+		}
+	}
+	static void decompressBlocks(istream& inFile, ostream& outFile, DecodeTableCache* cache)
+	{
+		BlockDecoder decoder(inFile, cache);
+		std::vector<Byte> block;
+
+		while (decoder.decodeBlock(block)) {
+			outFile.write(reinterpret_cast<char*>(block.data()), block.size());
+		}
+	}
 };
\ No newline at end of file
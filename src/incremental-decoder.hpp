@@ -0,0 +1,564 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "huffman-tree.hpp"
+#include "adaptive-huffman.hpp"
+#include "block-codec.hpp"
+#include "container-format.hpp"
+
+// Result of a call to IncrementalDecoder::decode
+enum class DecodeStatus
+{
+	// All the input given was consumed; call again with more
+	NEED_INPUT,
+	// The output buffer is full; call again with more room
+	NEED_OUTPUT,
+	// The end of the compressed data was reached
+	DONE
+};
+
+// Push-style decoder for every compressed format. The compressed data is
+// fed in chunks of any size as it arrives, and the decoded bytes are
+// written to buffers owned by the caller. Between calls the decoder only
+// keeps its position in the format, the pending bits (at most 8 bytes)
+// and the current tables; payloads are decoded straight from the chunks,
+// only headers and tables are buffered until complete.
+//
+// After an exception (corrupted data) the decoder must not be used again.
+class IncrementalDecoder
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+
+public:
+	// Block mode decoding tables are taken from `cache` when one is given
+	IncrementalDecoder(DecodeTableCache* cache = nullptr)
+		: cache(cache)
+	{
+	}
+
+	// Consumes input from `inBuff` and writes decoded bytes to `outBuff`,
+	// until one of them runs out or the data ends. `inUsed` and `outUsed`
+	// are set to the number of bytes consumed and produced by this call.
+	// Input left over after DONE does not belong to the compressed data.
+	DecodeStatus decode(const Byte* inBuff, size_t inBuffSize, size_t& inUsed,
+		Byte* outBuff, size_t outBuffSize, size_t& outUsed)
+	{
+		in = inBuff;
+		inEnd = inBuff + inBuffSize;
+		out = outBuff;
+		outEnd = outBuff + outBuffSize;
+
+		DecodeStatus status = run();
+
+		inUsed = static_cast<size_t>(in - inBuff);
+		outUsed = static_cast<size_t>(out - outBuff);
+		return status;
+	}
+
+	bool isDone() const
+	{
+		return stage == Stage::DONE;
+	}
+
+private:
+	enum class Stage
+	{
+		HEADER,
+		LEGACY_METADATA,
+		LEGACY_DATA,
+		ADAPTIVE_SIZE,
+		ADAPTIVE_DATA,
+		BLOCKS_INDEX_OFFSET,
+		BLOCK_TYPE,
+		BLOCK_FIELDS,
+		INDEX_FIELDS,
+		INDEX_ENTRIES,
+		BLOCK_TABLE,
+		BLOCK_DATA,
+		BLOCK_PADDING,
+		DONE
+	};
+
+	// No limit on the bits of the adaptive and original formats, which run
+	// to the end of the data. Their bytes are loaded only as the codes need 
+	// them, so that the input after the data is left alone.
+	static constexpr uint64_t UNBOUNDED = ~uint64_t(0);
+
+	DecodeTableCache* cache;
+	Stage stage = Stage::HEADER;
+
+	// Chunks of the current call
+	const Byte* in = nullptr;
+	const Byte* inEnd = nullptr;
+	Byte* out = nullptr;
+	Byte* outEnd = nullptr;
+
+	// Header fields or table being gathered
+	std::vector<Byte> field;
+
+	// Pending bits, left-aligned as in BitReader, and the number of bytes
+	// of the current payload not loaded yet. Past the end of a block
+	// payload the bits read as zeros.
+	uint64_t acc = 0;
+	size_t bitCount = 0;
+	uint64_t payloadRemaining = UNBOUNDED;
+	uint64_t symbolsRemaining = 0;
+
+	// Original format
+	HuffTree huffTree;
+	HuffTreeNodePtr nodePtr;
+
+	// Adaptive mode
+	std::unique_ptr<AdaptiveHuffModel> model;
+
+	// Block mode
+	uint64_t position = 0;
+	uint64_t indexOffset = 0;
+	uint64_t blockOffset = 0;
+	bool isLastIndex = false;
+	BlockType blockType = BlockType::RAW;
+	size_t tableSize = 0;
+	std::shared_ptr<const HuffDecodeTable> huffTable;
+	std::shared_ptr<const FseDecodeTable> fseTable;
+	uint32_t fseState = 0;
+	bool hasFseState = false;
+
+	DecodeStatus run()
+	{
+		for (;;) {
+			switch (stage) {
+			case Stage::HEADER:
+				if (!fillField(3)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				readHeader();
+				break;
+			case Stage::LEGACY_METADATA:
+				if (!fillField(field[0] * (size_t(field[1]) + 1) + 2)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				readLegacyMetadata();
+				break;
+			case Stage::LEGACY_DATA:
+				if (!decodeLegacy()) {
+					return (out == outEnd) ? DecodeStatus::NEED_OUTPUT : DecodeStatus::NEED_INPUT;
+				}
+				stage = Stage::DONE;
+				break;
+			case Stage::ADAPTIVE_SIZE:
+				if (!fillField(8)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				symbolsRemaining = readFieldUInt(0, 8);
+				field.clear();
+				model = std::make_unique<AdaptiveHuffModel>();
+				stage = Stage::ADAPTIVE_DATA;
+				break;
+			case Stage::ADAPTIVE_DATA:
+				if (!decodeAdaptive()) {
+					return (out == outEnd) ? DecodeStatus::NEED_OUTPUT : DecodeStatus::NEED_INPUT;
+				}
+				stage = Stage::DONE;
+				break;
+			case Stage::BLOCKS_INDEX_OFFSET:
+				if (!fillField(8)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				indexOffset = readFieldUInt(0, 8);
+				field.clear();
+				stage = Stage::BLOCK_TYPE;
+				break;
+			case Stage::BLOCK_TYPE:
+				if (!fillField(1)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				readBlockType();
+				break;
+			case Stage::BLOCK_FIELDS:
+				if (!fillField(10)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				readBlockFields();
+				break;
+			case Stage::INDEX_FIELDS:
+				if (!fillField(12)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				payloadRemaining = readFieldUInt(8, 4) * BlockEncoder::INDEX_ENTRY_SIZE;
+				field.clear();
+				stage = Stage::INDEX_ENTRIES;
+				break;
+			case Stage::INDEX_ENTRIES:
+				if (!skipPayload()) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				stage = isLastIndex ? Stage::DONE : Stage::BLOCK_TYPE;
+				break;
+			case Stage::BLOCK_TABLE:
+				if (!fillField(tableSize)) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				readBlockTable();
+				break;
+			case Stage::BLOCK_DATA:
+				if (!decodeBlock()) {
+					return (out == outEnd) ? DecodeStatus::NEED_OUTPUT : DecodeStatus::NEED_INPUT;
+				}
+				stage = Stage::BLOCK_PADDING;
+				break;
+			case Stage::BLOCK_PADDING:
+				if (!skipPayload()) {
+					return DecodeStatus::NEED_INPUT;
+				}
+				acc = 0;
+				bitCount = 0;
+				stage = Stage::BLOCK_TYPE;
+				break;
+			default:
+				return DecodeStatus::DONE;
+			}
+		}
+	}
+
+	// Gathers input into `field` until it holds `size` bytes
+	bool fillField(size_t size)
+	{
+		size_t numBytes = std::min(size - std::min(size, field.size()), static_cast<size_t>(inEnd - in));
+
+		field.insert(field.end(), in, in + numBytes);
+		in += numBytes;
+		position += numBytes;
+
+		return field.size() >= size;
+	}
+
+	uint64_t readFieldUInt(size_t pos, size_t numBytes) const
+	{
+		uint64_t value = 0;
+
+		for (size_t i = 0; i < numBytes; i++) {
+			value = (value << 8) | field[pos + i];
+		}
+
+		return value;
+	}
+
+	void readHeader()
+	{
+		if (field[0] != ContainerFormat::MAGIC[0] || field[1] != ContainerFormat::MAGIC[1]) {
+			// The bytes read so far start the metadata of the original format
+			stage = Stage::LEGACY_METADATA;
+			return;
+		}
+
+		if (field[2] == static_cast<Byte>(ContainerFormat::Mode::ADAPTIVE)) {
+			stage = Stage::ADAPTIVE_SIZE;
+		}
+		else if (field[2] == static_cast<Byte>(ContainerFormat::Mode::BLOCKS)) {
+			stage = Stage::BLOCKS_INDEX_OFFSET;
+		}
+		else {
+			throw std::runtime_error("Unsupported compressed file format.");
+		}
+
+		field.clear();
+	}
+
+	// Distinct byte count, size of the frequencies and the list of bytes
+	// along with their frequencies
+	void readLegacyMetadata()
+	{
+		size_t distinctBytes = field[0];
+		size_t minBytesFreq = field[1];
+
+		if (distinctBytes == 0) {
+			throw std::runtime_error("Corrupted compressed file.");
+		}
+
+		ByteFreqTable byteFreqs = { 0 };
+
+		for (size_t i = 0; i < distinctBytes; i++) {
+			size_t idx = i * (minBytesFreq + 1) + 2;
+
+			// A frequency of one needs no bytes at all
+			byteFreqs[field[idx]] = (minBytesFreq == 0) ? 1 : readFieldUInt(idx + 1, minBytesFreq);
+		}
+
+		huffTree = HuffTree(byteFreqs);
+		nodePtr = huffTree.getRoot();
+		symbolsRemaining = nodePtr->getFrequency();
+		payloadRemaining = UNBOUNDED;
+
+		field.clear();
+		stage = Stage::LEGACY_DATA;
+	}
+
+	void readBlockType()
+	{
+		blockOffset = position - 1;
+		blockType = static_cast<BlockType>(field[0]);
+		field.clear();
+
+		if (blockOffset > indexOffset) {
+			throw std::runtime_error("Corrupted block index.");
+		}
+
+		if (blockType != BlockType::INDEX) {
+			stage = Stage::BLOCK_FIELDS;
+		}
+		else {
+			// The last index is the one referenced by the file header, the 
+			// others were left behind by earlier appends
+			isLastIndex = (blockOffset == indexOffset);
+			stage = Stage::INDEX_FIELDS;
+		}
+	}
+
+	void readBlockFields()
+	{
+		symbolsRemaining = readFieldUInt(0, 4);
+		tableSize = readFieldUInt(4, 2);
+		payloadRemaining = readFieldUInt(6, 4);
+		field.clear();
+
+		if (symbolsRemaining > BlockEncoder::MAX_BLOCK_SIZE ||
+			payloadRemaining > BlockEncoder::getMaxPayloadSize(blockType, symbolsRemaining) ||
+			(blockType == BlockType::RAW && payloadRemaining != symbolsRemaining)) {
+			throw std::runtime_error("Corrupted block header.");
+		}
+
+		stage = Stage::BLOCK_TABLE;
+	}
+
+	void readBlockTable()
+	{
+		if (blockType == BlockType::HUFFMAN) {
+			if (tableSize > 0) {
+				huffTable = (cache != nullptr) ? cache->getHuffman(field) :
+					DecodeTables::buildHuffman(field);
+			}
+			else if (huffTable == nullptr) {
+				throw std::runtime_error("Block reuses a missing Huffman table.");
+			}
+		}
+		else if (blockType == BlockType::FSE) {
+			if (tableSize > 0) {
+				fseTable = (cache != nullptr) ? cache->getFse(field) :
+					DecodeTables::buildFse(field);
+			}
+			else if (fseTable == nullptr) {
+				throw std::runtime_error("Block reuses a missing FSE table.");
+			}
+			hasFseState = false;
+		}
+		else if (blockType != BlockType::RAW) {
+			throw std::runtime_error("Unknown block type.");
+		}
+
+		field.clear();
+		stage = Stage::BLOCK_DATA;
+	}
+
+	// Skips the rest of the current payload (or index entries)
+	bool skipPayload()
+	{
+		size_t numBytes = static_cast<size_t>(
+			std::min<uint64_t>(payloadRemaining, static_cast<uint64_t>(inEnd - in)));
+
+		in += numBytes;
+		position += numBytes;
+		payloadRemaining -= numBytes;
+
+		return payloadRemaining == 0;
+	}
+
+	bool loadByte()
+	{
+		if (in == inEnd) {
+			return false;
+		}
+
+		acc |= static_cast<uint64_t>(*in++) << (56 - bitCount);
+		bitCount += 8;
+		position++;
+		return true;
+	}
+
+	// Loads as much of a block payload as the pending bits can hold
+	void refill()
+	{
+		while (bitCount <= 56 && payloadRemaining > 0 && payloadRemaining != UNBOUNDED && loadByte()) {
+			payloadRemaining--;
+		}
+	}
+
+	void consumeBits(size_t numBits)
+	{
+		acc <<= numBits;
+		bitCount = (bitCount > numBits) ? bitCount - numBits : 0;
+	}
+
+	// Reads `numBits` bits (at most 32), unless they are not all in yet
+	bool readBits(size_t numBits, uint32_t& bits)
+	{
+		refill();
+
+		if (numBits > bitCount && payloadRemaining > 0) {
+			return false;
+		}
+
+		bits = static_cast<uint32_t>((acc >> 1) >> (63 - numBits));
+		consumeBits(numBits);
+		return true;
+	}
+
+	// Decodes a symbol with a table lookup on the pending bits. The lookup
+	// may be done with fewer than `tableLog` bits, as long as the code it
+	// finds is complete: codes are prefix free, so it is the right one.
+	bool decodeSymbol(const std::vector<DecodeEntry>& table, size_t tableLog, Byte& symbol)
+	{
+		refill();
+
+		DecodeEntry entry = table[(acc >> 1) >> (63 - tableLog)];
+
+		while (payloadRemaining == UNBOUNDED &&
+			(entry.numBits > bitCount || (entry.numBits == 0 && bitCount < tableLog))) {
+			if (!loadByte()) {
+				return false;
+			}
+			entry = table[(acc >> 1) >> (63 - tableLog)];
+		}
+
+		if (entry.numBits > bitCount && payloadRemaining > 0) {
+			return false;
+		}
+
+		if (entry.numBits == 0) {
+			throw std::runtime_error("Corrupted Huffman bitstream.");
+		}
+
+		consumeBits(entry.numBits);
+		symbol = entry.symbol;
+		return true;
+	}
+
+	// Walks the tree of the original format bit by bit
+	bool decodeLegacy()
+	{
+		HuffTreeNodePtr root = huffTree.getRoot();
+
+		while (symbolsRemaining > 0) {
+			if (out == outEnd) {
+				return false;
+			}
+
+			// A single distinct byte takes no bits at all
+			while (!nodePtr->isLeaf()) {
+				if (bitCount == 0 && !loadByte()) {
+					return false;
+				}
+
+				nodePtr = ((acc >> 63) == 0) ? nodePtr->getLeft() : nodePtr->getRight();
+				consumeBits(1);
+			}
+
+			*out++ = nodePtr->getByte().value();
+			symbolsRemaining--;
+			nodePtr = root;
+		}
+
+		return true;
+	}
+
+	bool decodeAdaptive()
+	{
+		while (symbolsRemaining > 0) {
+			Byte symbol;
+
+			if (out == outEnd ||
+				!decodeSymbol(model->getDecodeTable(), model->getCode().getMaxLength(), symbol)) {
+				return false;
+			}
+
+			*out++ = symbol;
+			model->update(symbol);
+			symbolsRemaining--;
+		}
+
+		return true;
+	}
+
+	bool decodeBlock()
+	{
+		if (blockType == BlockType::RAW) {
+			while (symbolsRemaining > 0) {
+				size_t numBytes = static_cast<size_t>(std::min<uint64_t>(symbolsRemaining,
+					std::min(inEnd - in, outEnd - out)));
+
+				if (numBytes == 0) {
+					return false;
+				}
+
+				std::memcpy(out, in, numBytes);
+				in += numBytes;
+				out += numBytes;
+				position += numBytes;
+				payloadRemaining -= numBytes;
+				symbolsRemaining -= numBytes;
+			}
+
+			return true;
+		}
+
+		if (blockType == BlockType::HUFFMAN) {
+			while (symbolsRemaining > 0) {
+				if (out == outEnd || !decodeSymbol(huffTable->entries, huffTable->tableLog, *out)) {
+					return false;
+				}
+
+				out++;
+				symbolsRemaining--;
+			}
+
+			return true;
+		}
+
+		if (!hasFseState && symbolsRemaining > 0) {
+			if (!readBits(fseTable->tableLog, fseState)) {
+				return false;
+			}
+			hasFseState = true;
+		}
+
+		while (symbolsRemaining > 0) {
+			if (out == outEnd) {
+				return false;
+			}
+
+			const FseDecodeEntry& entry = fseTable->entries[fseState];
+
+			// The state after the last symbol is never used
+			if (symbolsRemaining > 1) {
+				uint32_t bits;
+
+				if (!readBits(entry.numBits, bits)) {
+					return false;
+				}
+				fseState = entry.newState + bits;
+			}
+
+			*out++ = entry.symbol;
+			symbolsRemaining--;
+		}
+
+		return true;
+	}
+};
\ No newline at end of file
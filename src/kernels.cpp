@@ -0,0 +1,418 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HAS_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define HAS_X86_KERNELS 0
+#endif
+
+namespace
+{
+// Bytes counted per pass, small enough for 32-bit partial counts
+constexpr size_t COUNT_CHUNK_SIZE = size_t(1) << 30;
+constexpr size_t NUM_PARTIAL_HISTOGRAMS = 4;
+
+using PartialHistograms = uint32_t[NUM_PARTIAL_HISTOGRAMS][256];
+
+CpuPath detectSupportedPath()
+{
+#if HAS_X86_KERNELS
+	__builtin_cpu_init();
+
+	bool hasBmi2 = __builtin_cpu_supports("bmi2");
+
+	if (hasBmi2 && __builtin_cpu_supports("avx2")) {
+		return CpuPath::AVX2;
+	}
+	if (hasBmi2) {
+		return CpuPath::BMI2;
+	}
+#endif
+	return CpuPath::SCALAR;
+}
+
+const CpuPath supportedPath = detectSupportedPath();
+std::atomic<CpuPath> activePath{ supportedPath };
+
+void storeBigEndian32(Byte* out, uint32_t value)
+{
+	out[0] = static_cast<Byte>(value >> 24);
+	out[1] = static_cast<Byte>(value >> 16);
+	out[2] = static_cast<Byte>(value >> 8);
+	out[3] = static_cast<Byte>(value);
+}
+
+uint64_t loadBigEndian64(const Byte* in)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < 8; i++) {
+		value = (value << 8) | in[i];
+	}
+
+	return value;
+}
+
+// Same as loadBigEndian64, with zeros in place of the bytes past the end
+uint64_t loadBigEndian64Padded(const Byte* in, size_t inSize, size_t pos)
+{
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < 8; i++) {
+		value = (value << 8) | ((pos + i < inSize) ? in[pos + i] : 0);
+	}
+
+	return value;
+}
+
+// Counts into interleaved partial histograms, so that runs of the same
+// byte don't stall on a single counter.
+void countPartial(const Byte* in, size_t size, PartialHistograms& counts)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= size; i += 4) {
+		counts[0][in[i]]++;
+		counts[1][in[i + 1]]++;
+		counts[2][in[i + 2]]++;
+		counts[3][in[i + 3]]++;
+	}
+
+	for (; i < size; i++) {
+		counts[0][in[i]]++;
+	}
+}
+
+size_t encodeHuffmanBody(const Byte* in, size_t size, const uint16_t* codes,
+	const Byte* lengths, Byte* out)
+{
+	Byte* outPtr = out;
+	uint64_t acc = 0;
+	size_t bitCount = 0;
+	size_t i = 0;
+
+	// Fewer than 32 pending bits plus two codes of at most 15 bits always
+	// fit in the accumulator, so a word is spilled every two symbols at most
+	for (; i + 2 <= size; i += 2) {
+		Byte first = in[i];
+		Byte second = in[i + 1];
+
+		acc = (acc << lengths[first]) | codes[first];
+		acc = (acc << lengths[second]) | codes[second];
+		bitCount += lengths[first] + lengths[second];
+
+		if (bitCount >= 32) {
+			bitCount -= 32;
+			storeBigEndian32(outPtr, static_cast<uint32_t>(acc >> bitCount));
+			outPtr += 4;
+		}
+	}
+
+	if (i < size) {
+		acc = (acc << lengths[in[i]]) | codes[in[i]];
+		bitCount += lengths[in[i]];
+	}
+
+	while (bitCount >= 8) {
+		bitCount -= 8;
+		*outPtr++ = static_cast<Byte>(acc >> bitCount);
+	}
+
+	if (bitCount > 0) {
+		*outPtr++ = static_cast<Byte>(acc << (8 - bitCount));
+	}
+
+	return static_cast<size_t>(outPtr - out);
+}
+
+void decodeHuffmanBody(const Byte* in, size_t inSize, const DecodeEntry* table,
+	size_t tableLog, Byte* out, size_t outSize, size_t bitPos = 0)
+{
+	if (outSize > 0 && tableLog == 0) {
+		throw std::runtime_error("Corrupted Huffman bitstream.");
+	}
+
+	size_t shift = 64 - tableLog;
+	size_t i = 0;
+
+	// A refill gives at least 57 valid bits, enough for three codes of up
+	// to 15 bits. The loads stay inside the input until its last 8 bytes.
+	while (i + 3 <= outSize && (bitPos >> 3) + 8 <= inSize) {
+		uint64_t acc = loadBigEndian64(in + (bitPos >> 3)) << (bitPos & 7);
+
+		for (size_t k = 0; k < 3; k++) {
+			DecodeEntry entry = table[acc >> shift];
+
+			if (entry.numBits == 0) {
+				throw std::runtime_error("Corrupted Huffman bitstream.");
+			}
+
+			acc <<= entry.numBits;
+			bitPos += entry.numBits;
+			out[i++] = entry.symbol;
+		}
+	}
+
+	while (i < outSize) {
+		uint64_t acc = loadBigEndian64Padded(in, inSize, bitPos >> 3) << (bitPos & 7);
+		DecodeEntry entry = table[acc >> shift];
+
+		if (entry.numBits == 0) {
+			throw std::runtime_error("Corrupted Huffman bitstream.");
+		}
+
+		bitPos += entry.numBits;
+		out[i++] = entry.symbol;
+	}
+}
+
+void mergeScalar(const PartialHistograms& counts, std::array<uint64_t, 256>& byteFreqs)
+{
+	for (size_t byte = 0; byte < 256; byte++) {
+		byteFreqs[byte] += uint64_t(counts[0][byte]) + counts[1][byte] + counts[2][byte] + counts[3][byte];
+	}
+}
+
+#if HAS_X86_KERNELS
+// Codes and lengths packed in one word (code << 8 | length), so a symbol
+// costs a single table load
+using PackedCodes = uint32_t[256];
+
+__attribute__((target("bmi2")))
+inline uint64_t loadBigEndian64Bmi2(const Byte* in)
+{
+	uint64_t value;
+	std::memcpy(&value, in, sizeof(value));
+	return __builtin_bswap64(value);
+}
+
+// Two codes are joined before they reach the accumulator, which halves
+// the chain of dependent shifts through it. The shifts are flag-free
+// shlx/shrx and each spill is a single byte-swapped 32-bit store.
+__attribute__((target("bmi2")))
+size_t encodeBmi2(const Byte* in, size_t size, const PackedCodes& packed, Byte* out)
+{
+	Byte* outPtr = out;
+	uint64_t acc = 0;
+	size_t bitCount = 0;
+	size_t i = 0;
+
+	for (; i + 2 <= size; i += 2) {
+		uint32_t first = packed[in[i]];
+		uint32_t second = packed[in[i + 1]];
+		uint32_t secondLength = second & 0xFF;
+		uint64_t pair = (uint64_t(first >> 8) << secondLength) | (second >> 8);
+		uint32_t pairLength = (first & 0xFF) + secondLength;
+
+		acc = (acc << pairLength) | pair;
+		bitCount += pairLength;
+
+		if (bitCount >= 32) {
+			bitCount -= 32;
+			uint32_t word = __builtin_bswap32(static_cast<uint32_t>(acc >> bitCount));
+			std::memcpy(outPtr, &word, sizeof(word));
+			outPtr += 4;
+		}
+	}
+
+	if (i < size) {
+		acc = (acc << (packed[in[i]] & 0xFF)) | (packed[in[i]] >> 8);
+		bitCount += packed[in[i]] & 0xFF;
+	}
+
+	while (bitCount >= 8) {
+		bitCount -= 8;
+		*outPtr++ = static_cast<Byte>(acc >> bitCount);
+	}
+
+	if (bitCount > 0) {
+		*outPtr++ = static_cast<Byte>(acc << (8 - bitCount));
+	}
+
+	return static_cast<size_t>(outPtr - out);
+}
+
+// Resolves `N` codes per 8-byte load, as many as 57 valid bits hold for
+// the table. The bits are never shifted out of the loaded word: each code
+// is cut from it with shrx and bzhi, so the codes only depend on each
+// other through the bit count. A corrupted code is reported after the
+// group rather than at once.
+template <size_t N>
+__attribute__((target("bmi2")))
+size_t decodeGroupsBmi2(const Byte* in, size_t inSize, const DecodeEntry* table, size_t tableLog,
+	Byte* out, size_t outSize, size_t& bitPos)
+{
+	size_t i = 0;
+	unsigned corrupted = 0;
+
+	while (i + N <= outSize && (bitPos >> 3) + 8 <= inSize) {
+		uint64_t word = loadBigEndian64Bmi2(in + (bitPos >> 3));
+		size_t available = 64 - (bitPos & 7);
+
+		for (size_t k = 0; k < N; k++) {
+			DecodeEntry entry = table[_bzhi_u64(word >> (available - tableLog), static_cast<unsigned>(tableLog))];
+
+			corrupted |= (entry.numBits == 0);
+			available -= entry.numBits;
+			out[i++] = entry.symbol;
+		}
+
+		bitPos = (bitPos & ~size_t(7)) + 64 - available;
+
+		if (corrupted != 0) {
+			throw std::runtime_error("Corrupted Huffman bitstream.");
+		}
+	}
+
+	return i;
+}
+
+__attribute__((target("bmi2")))
+void decodeBmi2(const Byte* in, size_t inSize, const DecodeEntry* table, size_t tableLog,
+	Byte* out, size_t outSize)
+{
+	if (outSize > 0 && tableLog == 0) {
+		throw std::runtime_error("Corrupted Huffman bitstream.");
+	}
+
+	size_t bitPos = 0;
+	size_t i;
+
+	if (tableLog <= 11) {
+		i = decodeGroupsBmi2<5>(in, inSize, table, tableLog, out, outSize, bitPos);
+	}
+	else if (tableLog <= 14) {
+		i = decodeGroupsBmi2<4>(in, inSize, table, tableLog, out, outSize, bitPos);
+	}
+	else {
+		i = decodeGroupsBmi2<3>(in, inSize, table, tableLog, out, outSize, bitPos);
+	}
+
+	// The tail goes through the zero-padded scalar loop
+	decodeHuffmanBody(in + (bitPos >> 3), inSize - (bitPos >> 3), table, tableLog, out + i, outSize - i,
+		bitPos & 7);
+}
+
+// Sums the partial histograms eight counters at a time and widens the
+// sums to 64 bits before adding them to the totals.
+__attribute__((target("avx2")))
+void mergeAvx2(const PartialHistograms& counts, std::array<uint64_t, 256>& byteFreqs)
+{
+	for (size_t byte = 0; byte < 256; byte += 8) {
+		__m256i sum = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&counts[0][byte]));
+
+		for (size_t j = 1; j < NUM_PARTIAL_HISTOGRAMS; j++) {
+			sum = _mm256_add_epi32(sum,
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&counts[j][byte])));
+		}
+
+		__m256i* totals = reinterpret_cast<__m256i*>(&byteFreqs[byte]);
+		__m256i low = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sum));
+		__m256i high = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sum, 1));
+
+		_mm256_storeu_si256(totals, _mm256_add_epi64(_mm256_loadu_si256(totals), low));
+		_mm256_storeu_si256(totals + 1, _mm256_add_epi64(_mm256_loadu_si256(totals + 1), high));
+	}
+}
+#endif
+}
+
+namespace Kernels
+{
+CpuPath detectCpuPath()
+{
+	return supportedPath;
+}
+
+void setCpuPath(CpuPath path)
+{
+	if (static_cast<int>(path) > static_cast<int>(supportedPath)) {
+		throw std::runtime_error("This CPU does not support the " + getCpuPathName(path) + " code path.");
+	}
+
+	activePath = path;
+}
+
+CpuPath getCpuPath()
+{
+	return activePath;
+}
+
+std::string getCpuPathName(CpuPath path)
+{
+	switch (path) {
+	case CpuPath::BMI2:
+		return "bmi2";
+	case CpuPath::AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+void countBytes(const Byte* inBuff, size_t inBuffSize, std::array<uint64_t, 256>& byteFreqs)
+{
+	for (size_t pos = 0; pos < inBuffSize; pos += COUNT_CHUNK_SIZE) {
+		PartialHistograms counts = { { 0 } };
+		countPartial(inBuff + pos, std::min(COUNT_CHUNK_SIZE, inBuffSize - pos), counts);
+
+#if HAS_X86_KERNELS
+		if (activePath == CpuPath::AVX2) {
+			mergeAvx2(counts, byteFreqs);
+			continue;
+		}
+#endif
+		mergeScalar(counts, byteFreqs);
+	}
+}
+
+void encodeHuffman(const Byte* inBuff, size_t inBuffSize, const CanonicalCode& code,
+	std::vector<Byte>& outBytes)
+{
+	// Codes are at most 15 bits, so two bytes per symbol always suffice
+	outBytes.resize(2 * inBuffSize + 8);
+
+	const uint16_t* codes = code.getCodes().data();
+	const Byte* lengths = code.getLengths().data();
+	size_t outSize;
+
+#if HAS_X86_KERNELS
+	if (activePath != CpuPath::SCALAR) {
+		PackedCodes packed;
+		for (size_t byte = 0; byte < 256; byte++) {
+			packed[byte] = (uint32_t(codes[byte]) << 8) | lengths[byte];
+		}
+
+		outSize = encodeBmi2(inBuff, inBuffSize, packed, outBytes.data());
+	}
+	else
+#endif
+	{
+		outSize = encodeHuffmanBody(inBuff, inBuffSize, codes, lengths, outBytes.data());
+	}
+
+	outBytes.resize(outSize);
+}
+
+void decodeHuffman(const Byte* inBuff, size_t inBuffSize, const std::vector<DecodeEntry>& table,
+	size_t tableLog, Byte* outBuff, size_t outBuffSize)
+{
+	if (tableLog > CanonicalCode::MAX_CODE_LENGTH || table.size() != (size_t(1) << tableLog)) {
+		throw std::runtime_error("Corrupted Huffman table.");
+	}
+
+#if HAS_X86_KERNELS
+	if (activePath != CpuPath::SCALAR) {
+		decodeBmi2(inBuff, inBuffSize, table.data(), tableLog, outBuff, outBuffSize);
+		return;
+	}
+#endif
+	decodeHuffmanBody(inBuff, inBuffSize, table.data(), tableLog, outBuff, outBuffSize);
+}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "canonical-code.hpp"
+
+// Instruction sets the block coding kernels are specialized for
+enum class CpuPath
+{
+	SCALAR,
+	// Bit extraction with shrx/bzhi, several codes per load when decoding
+	// and joined code pairs when encoding
+	BMI2,
+	// BMI2 plus vector merging of the partial histograms
+	AVX2
+};
+
+// Hot loops of the block mode, working on whole blocks in memory. Every
+// kernel has a portable scalar version and versions for newer x86
+// extensions; the best one the CPU supports is picked at runtime, so a
+// generic build still uses them. All paths give the same output.
+namespace Kernels
+{
+// Best path supported by this CPU, as reported by CPUID
+CpuPath detectCpuPath();
+
+// Forces the kernels to the given path, mostly for testing. Throws if
+// the CPU doesn't support it.
+void setCpuPath(CpuPath path);
+CpuPath getCpuPath();
+std::string getCpuPathName(CpuPath path);
+
+// Adds the byte counts of the buffer to `byteFreqs`
+void countBytes(const Byte* inBuff, size_t inBuffSize, std::array<uint64_t, 256>& byteFreqs);
+
+// Codes the buffer into `outBytes` (replacing its contents), MSB-first
+// and zero padded, exactly as BitWriter would.
+void encodeHuffman(const Byte* inBuff, size_t inBuffSize, const CanonicalCode& code,
+	std::vector<Byte>& outBytes);
+
+// Decodes `outBuffSize` bytes with a table built by
+// CanonicalCode::buildDecodeTable. Bits past the end of the input read as
+// zeros, as with BitReader.
+void decodeHuffman(const Byte* inBuff, size_t inBuffSize, const std::vector<DecodeEntry>& table,
+	size_t tableLog, Byte* outBuff, size_t outBuffSize);
+}
\ No newline at end of file
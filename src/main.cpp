@@ -4,8 +4,12 @@
 #include <filesystem>
 #include <stdexcept>
 #include <algorithm>
+#include <optional>
+#include <iomanip>
 
 #include "huffman.hpp"
+#include "daemon.h"
+#include "kernels.h"
 #include "path-manager.h"
 #include "messages.h"
 
@@ -14,12 +18,29 @@ namespace fs = std::filesystem;
 // Constants
 static const std::string ZIP_CMD = "zip";
 static const std::string UNZIP_CMD = "unzip";
+static const std::string SERVE_CMD = "serve";
+static const std::string STATS_CMD = "stats";
 static const std::string ZIPPED_EXT = ".hzip";
+static const std::string ADAPTIVE_OPT = "--adaptive";
+static const std::string ENTROPY_OPT = "--entropy=";
+static const std::string AUTO_OPT = "--auto";
+static const std::string TARGET_OPT = "--target-mbps=";
+static const std::string APPEND_OPT = "--append";
+static const std::string SAMPLED_OPT = "--sampled";
+static const std::string DAEMON_OPT = "--daemon=";
+static const std::string WORKERS_OPT = "--workers=";
+static const std::string CPU_OPT = "--cpu=";
 
 enum Operation { ZIP = 1, UNZIP = 2 };
 
 // Function prototypes
-bool isValidCommandLineArgs(int argc, const std::string& command);
+bool isValidCommandLineArgs(size_t numPaths, const std::string& command);
+EntropyMode parseEntropyMode(const std::string& value);
+int parseLevel(const std::string& arg);
+double parseTargetMBps(const std::string& value);
+size_t parseWorkers(const std::string& value);
+CpuPath parseCpuPath(const std::string& value);
+void rejectRepeatedOption(bool isSet);
 int processCommandLineArgs(int argc, char** argv);
 int promptUserForOperation();
 int compressFile();
@@ -48,11 +69,118 @@ int processCommandLineArgs(int argc, char** argv) {
 	std::string command(argv[1]);
 	std::transform(command.begin(), command.end(), command.begin(), ::tolower);
 
-	if (!isValidCommandLineArgs(argc, command)) {
+	// Split the remaining arguments into options and file paths
+	std::vector<std::string> paths;
+	CompressionOptions options;
+	std::optional<EntropyMode> entropyMode;
+	std::optional<int> explicitLevel;
+	std::optional<size_t> numWorkers;
+	std::optional<double> targetMBps;
+	std::optional<CpuPath> cpuPath;
+	bool adaptive = false;
+	bool autoLevel = false;
+	bool append = false;
+	bool sampled = false;
+	bool daemon = false;
+	std::string daemonSocket;
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg(argv[i]);
+
+		if (arg == ADAPTIVE_OPT) {
+			rejectRepeatedOption(adaptive);
+			adaptive = true;
+		}
+		else if (arg.rfind(ENTROPY_OPT, 0) == 0) {
+			rejectRepeatedOption(entropyMode.has_value());
+			entropyMode = parseEntropyMode(arg.substr(ENTROPY_OPT.size()));
+		}
+		else if (arg == APPEND_OPT) {
+			rejectRepeatedOption(append);
+			append = true;
+		}
+		else if (arg == SAMPLED_OPT) {
+			rejectRepeatedOption(sampled);
+			sampled = true;
+		}
+		else if (arg == AUTO_OPT) {
+			rejectRepeatedOption(autoLevel);
+			autoLevel = true;
+		}
+		else if (arg.rfind(DAEMON_OPT, 0) == 0) {
+			rejectRepeatedOption(daemon);
+			daemon = true;
+			daemonSocket = arg.substr(DAEMON_OPT.size());
+		}
+		else if (arg.rfind(WORKERS_OPT, 0) == 0) {
+			rejectRepeatedOption(numWorkers.has_value());
+			numWorkers = parseWorkers(arg.substr(WORKERS_OPT.size()));
+		}
+		else if (arg.rfind(CPU_OPT, 0) == 0) {
+			rejectRepeatedOption(cpuPath.has_value());
+			cpuPath = parseCpuPath(arg.substr(CPU_OPT.size()));
+		}
+		else if (arg.rfind(TARGET_OPT, 0) == 0) {
+			rejectRepeatedOption(targetMBps.has_value());
+			targetMBps = parseTargetMBps(arg.substr(TARGET_OPT.size()));
+		}
+		else if (arg.size() == 2 && arg[0] == '-' && isdigit(arg[1])) {
+			rejectRepeatedOption(explicitLevel.has_value());
+			explicitLevel = parseLevel(arg);
+		}
+		else if (arg.rfind("-", 0) == 0) {
+			throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+		}
+		else {
+			paths.push_back(arg);
+		}
+	}
+
+	bool blocksOption = entropyMode.has_value() || explicitLevel.has_value() || autoLevel || append || sampled;
+
+	// Options must not contradict each other nor be meaningless for the
+	// command, rather than the last one silently winning
+	if (!isValidCommandLineArgs(paths.size(), command) ||
+		((adaptive || blocksOption || targetMBps.has_value()) && command != ZIP_CMD) ||
+		(daemon && (daemonSocket.empty() || (command != ZIP_CMD && command != UNZIP_CMD))) ||
+		(numWorkers.has_value() && command != SERVE_CMD) ||
+		(adaptive && blocksOption) ||
+		(autoLevel && explicitLevel.has_value()) ||
+		(targetMBps.has_value() && !autoLevel) ||
+		(sampled && entropyMode.has_value()) ||
+		(append && (daemon || sampled)) ||
+		(cpuPath.has_value() && (daemon || command == STATS_CMD))) {
 		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
 	}
 
-	std::string inputFilePath(argv[2]);
+	if (cpuPath.has_value()) {
+		Kernels::setCpuPath(cpuPath.value());
+	}
+
+	if (adaptive) {
+		options.mode = CompressionMode::ADAPTIVE;
+	}
+	else if (sampled) {
+		// The sampled mode takes the block size and code length of the level
+		options.mode = CompressionMode::SAMPLED;
+	}
+	else if (blocksOption) {
+		options.mode = CompressionMode::BLOCKS;
+	}
+
+	int level = explicitLevel.value_or(CompressionLevel::DEFAULT_LEVEL);
+
+	// Daemon commands take the socket path instead of files
+	if (command == SERVE_CMD) {
+		return runDaemon(paths[0], numWorkers.value_or(0));
+	}
+
+	if (command == STATS_CMD) {
+		std::cout << daemonStats(paths[0]);
+		return 0;
+	}
+
+	std::string inputFilePath(paths[0]);
 
 	if (!fs::exists(inputFilePath)) {
 		std::cout << "Error: The specified input file does not exist." << std::endl;
@@ -61,9 +189,9 @@ int processCommandLineArgs(int argc, char** argv) {
 
 	std::string outputFilePath;
 
-	if (argc == 4) {
+	if (paths.size() == 2) {
 		// Get provided output file path if the user provided one
-		outputFilePath = argv[3];
+		outputFilePath = paths[1];
 
 		// Put a default extension (".hzip") if the user didn't provide one
 		if (!hasExtension(outputFilePath)) {
@@ -77,17 +205,50 @@ int processCommandLineArgs(int argc, char** argv) {
 	}
 
 	if (command == ZIP_CMD) {
+		if (autoLevel) {
+			level = CompressionLevel::pickLevel(inputFilePath, targetMBps.value_or(CompressionLevel::DEFAULT_TARGET_MBPS));
+			std::cout << "Selected compression level " << level << "." << std::endl;
+		}
+
+		// An explicit entropy coder overrides the one of the level
+		options.blockSettings = CompressionLevel::getSettings(level);
+		if (entropyMode.has_value()) {
+			options.blockSettings.entropyMode = entropyMode.value();
+		}
+
+		SampledStats sampledStats;
+
 		try {
-			Compressor::zip(inputFilePath, outputFilePath);
+			if (!daemonSocket.empty()) {
+				daemonZip(daemonSocket, inputFilePath, outputFilePath, options);
+			}
+			else if (append) {
+				Compressor::append(inputFilePath, outputFilePath, options.blockSettings);
+			}
+			else {
+				Compressor::zip(inputFilePath, outputFilePath, options, &sampledStats);
+			}
 		}
 		catch (std::exception& e) {
 			throw;
 		}
 		std::cout << "File compressed successfully!" << std::endl;
+
+		if (sampled && daemonSocket.empty()) {
+			std::cout << "Sampled table: " << sampledStats.compressedBytes << " bytes, ratio penalty " << 
+				std::showpos << std::fixed << std::setprecision(2) << sampledStats.getRatioPenalty() * 100 << 
+				std::noshowpos << "% against a full-histogram table (" << sampledStats.numEscapes << 
+				" block escapes)." << std::endl;
+		}
 	} 
 	else {
 		try {
-			Decompressor::unzip(inputFilePath, outputFilePath);
+			if (!daemonSocket.empty()) {
+				daemonUnzip(daemonSocket, inputFilePath, outputFilePath);
+			}
+			else {
+				Decompressor::unzip(inputFilePath, outputFilePath);
+			}
 		}
 		catch (std::exception& e) {
 			throw;
@@ -98,10 +259,89 @@ int processCommandLineArgs(int argc, char** argv) {
 	return 0;
 }
 
-bool isValidCommandLineArgs(int argc, const std::string& command) {
-	return !(argc > 4 || argc < 3 ||
+bool isValidCommandLineArgs(size_t numPaths, const std::string& command) {
+	if (command == SERVE_CMD || command == STATS_CMD) {
+		return numPaths == 1;
+	}
+
+	return !(numPaths > 2 || numPaths < 1 ||
 		!(command == ZIP_CMD || command == UNZIP_CMD) ||
-		(command == UNZIP_CMD && argc != 4));
+		(command == UNZIP_CMD && numPaths != 2));
+}
+
+EntropyMode parseEntropyMode(const std::string& value) {
+	if (value == "huffman") {
+		return EntropyMode::HUFFMAN;
+	}
+	if (value == "fse") {
+		return EntropyMode::FSE;
+	}
+	if (value == "auto") {
+		return EntropyMode::AUTO;
+	}
+	throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+}
+
+int parseLevel(const std::string& arg) {
+	int level = arg[1] - '0';
+
+	if (level < CompressionLevel::MIN_LEVEL || level > CompressionLevel::MAX_LEVEL) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
+	return level;
+}
+
+double parseTargetMBps(const std::string& value) {
+	size_t end = 0;
+	double targetMBps = 0;
+
+	try {
+		targetMBps = std::stod(value, &end);
+	}
+	catch (std::exception&) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
+
+	if (end != value.size() || targetMBps <= 0) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
+	return targetMBps;
+}
+
+size_t parseWorkers(const std::string& value) {
+	size_t end = 0;
+	unsigned long numWorkers = 0;
+
+	try {
+		numWorkers = std::stoul(value, &end);
+	}
+	catch (std::exception&) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
+
+	if (end != value.size() || numWorkers == 0) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
+	return numWorkers;
+}
+
+CpuPath parseCpuPath(const std::string& value) {
+	if (value == "scalar") {
+		return CpuPath::SCALAR;
+	}
+	if (value == "bmi2") {
+		return CpuPath::BMI2;
+	}
+	if (value == "avx2") {
+		return CpuPath::AVX2;
+	}
+	throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+}
+
+void rejectRepeatedOption(bool isSet) {
+	if (isSet) {
+		throw std::invalid_argument(Messages::INVALID_ARGUMENTS);
+	}
 }
 
 int promptUserForOperation() {
@@ -3,10 +3,23 @@
 namespace Messages 
 {
 const std::string INVALID_COMMAND =     "Invalid command line arguments.\n";
-const std::string USAGE =               "Usage: huffman <command> <input_file> [<output_file>]\n";
+const std::string USAGE =               "Usage: huffman <command> [<options>] <input_file> [<output_file>]\n"
+                                        "       huffman serve [--workers=<n>] [--cpu=<path>] <socket>\n"
+                                        "       huffman stats <socket>\n";
 const std::string OPTIONS_COMMAND =     "  <command>       Specify the operation to perform: \"zip\" for compression or \"unzip\" for decompression.\n";
 const std::string OPTIONS_INPUT_FILE =  "  <input_file>    Path to the file to be processed.\n";
 const std::string OPTIONS_OUTPUT_FILE = "  [<output_file>] Path to the resulting file. Optional for \"zip\" operation; required for \"unzip\" operation.\n";
-const std::string OPTIONS = "\nOptions:\n" + OPTIONS_COMMAND + OPTIONS_INPUT_FILE + OPTIONS_OUTPUT_FILE;
+const std::string OPTIONS_ADAPTIVE =    "  --adaptive      One-pass adaptive coding with no stored frequency table (\"zip\" only).\n";
+const std::string OPTIONS_ENTROPY =     "  --entropy=<coder> Block mode with the given entropy coder: \"huffman\", \"fse\" or \"auto\" (\"zip\" only).\n";
+const std::string OPTIONS_LEVEL =       "  -1 ... -9       Block mode with the given compression level, from fastest to best ratio (\"zip\" only).\n";
+const std::string OPTIONS_AUTO =        "  --auto          Block mode with the best level that keeps up with --target-mbps=<n> (default: 100) on a sample of the input.\n";
+const std::string OPTIONS_APPEND =      "  --append        Add the input as new blocks at the end of an existing block mode <output_file> (\"zip\" only).\n";
+const std::string OPTIONS_SAMPLED =     "  --sampled       Block mode with a single read of the input and one Huffman table built from a sample of it (\"zip\" only).\n";
+const std::string OPTIONS_DAEMON =      "  --daemon=<socket> Let the daemon listening on <socket> do the work; the files are passed as descriptors.\n";
+const std::string OPTIONS_CPU =         "  --cpu=<path>    Force the block coding kernels to \"scalar\", \"bmi2\" or \"avx2\" instead of the best path of this CPU.\n";
+const std::string OPTIONS_SERVE =       "  serve           Run the compression daemon on <socket> with a pool of --workers=<n> threads.\n"
+                                        "  stats           Print the metrics of the daemon listening on <socket>.\n";
+const std::string OPTIONS = "\nOptions:\n" + OPTIONS_COMMAND + OPTIONS_INPUT_FILE + OPTIONS_OUTPUT_FILE + OPTIONS_ADAPTIVE + OPTIONS_ENTROPY + 
+	OPTIONS_LEVEL + OPTIONS_AUTO + OPTIONS_APPEND + OPTIONS_SAMPLED + OPTIONS_DAEMON + OPTIONS_CPU + OPTIONS_SERVE;
 const std::string INVALID_ARGUMENTS = INVALID_COMMAND + USAGE + OPTIONS;
 }
\ No newline at end of file
@@ -9,6 +9,15 @@ extern const std::string USAGE;
 extern const std::string OPTIONS_COMMAND;
 extern const std::string OPTIONS_INPUT_FILE;
 extern const std::string OPTIONS_OUTPUT_FILE;
+extern const std::string OPTIONS_ADAPTIVE;
+extern const std::string OPTIONS_ENTROPY;
+extern const std::string OPTIONS_LEVEL;
+extern const std::string OPTIONS_AUTO;
+extern const std::string OPTIONS_APPEND;
+extern const std::string OPTIONS_SAMPLED;
+extern const std::string OPTIONS_DAEMON;
+extern const std::string OPTIONS_CPU;
+extern const std::string OPTIONS_SERVE;
 extern const std::string OPTIONS;
 extern const std::string INVALID_ARGUMENTS;
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <iostream>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include "canonical-code.hpp"
+#include "kernels.h"
+
+// Size report of the sampled mode. The penalty compares the output with
+// the same blocks coded by a table built from the histogram of the whole
+// input, which is what reading the input twice would have bought.
+struct SampledStats
+{
+	uint64_t inputBytes = 0;
+	uint64_t compressedBytes = 0;
+	uint64_t fullTableBytes = 0;
+	// Blocks the sampled table was too far off for
+	size_t numEscapes = 0;
+
+	double getRatioPenalty() const
+	{
+		if (fullTableBytes == 0) {
+			return 0;
+		}
+
+		return static_cast<double>(compressedBytes) / fullTableBytes - 1;
+	}
+};
+
+// Huffman tables of the sampled mode, built before the input is read in
+// full. Laplace smoothing gives every byte value one extra count, so bytes
+// missing from the sample still get a (long) code and any input can be
+// coded with the table.
+class SampledTable
+{
+private:
+	// Alias declarations
+	using ByteFreqTable = std::array<uint64_t, 256>;
+	using ios = std::ios;
+
+public:
+	static constexpr size_t NUM_SLICES = 16;
+	static constexpr size_t SLICE_SIZE = size_t(1) << 14;
+	// How much worse than on the sample (in bits per byte) the table may
+	// code a block before the block gets a table of its own
+	static constexpr double ESCAPE_TOLERANCE = 0.1;
+
+	// Counts the bytes of slices spread evenly over the rest of the input
+	// and seeks back to where it started. Returns false, leaving the
+	// stream where it was, if the stream can't seek (e.g. a pipe) or
+	// the rest of it fits in `minSize` bytes.
+	static bool readStridedSample(std::istream& inStream, uint64_t minSize, ByteFreqTable& sampleFreqs)
+	{
+		std::streampos start = inStream.tellg();
+
+		if (start == std::streampos(-1) || !inStream.seekg(0, ios::end)) {
+			inStream.clear();
+			return false;
+		}
+
+		uint64_t size = static_cast<uint64_t>(inStream.tellg() - start);
+
+		if (size <= minSize) {
+			inStream.seekg(start);
+			return false;
+		}
+
+		uint64_t stride = size / NUM_SLICES;
+		std::vector<Byte> slice(static_cast<size_t>(std::min<uint64_t>(SLICE_SIZE, stride)));
+
+		for (size_t i = 0; i < NUM_SLICES; i++) {
+			inStream.seekg(start + static_cast<std::streamoff>(i * stride));
+			inStream.read(reinterpret_cast<char*>(slice.data()), slice.size());
+			Kernels::countBytes(slice.data(), static_cast<size_t>(inStream.gcount()), sampleFreqs);
+		}
+
+		inStream.clear();
+		inStream.seekg(start);
+		return true;
+	}
+
+	static CanonicalCode build(const ByteFreqTable& sampleFreqs, size_t maxCodeLength)
+	{
+		ByteFreqTable smoothedFreqs;
+
+		// Codes for all 256 byte values take at least 8 bits
+		maxCodeLength = std::max<size_t>(maxCodeLength, 8);
+
+		for (size_t byte = 0; byte < 256; byte++) {
+			smoothedFreqs[byte] = sampleFreqs[byte] + 1;
+		}
+
+		return CanonicalCode(smoothedFreqs, maxCodeLength);
+	}
+
+	// Average number of bits per byte the code spends on the histogram
+	static double getBitsPerByte(const CanonicalCode& code, const ByteFreqTable& byteFreqs)
+	{
+		uint64_t total = 0;
+		for (uint64_t freq : byteFreqs) {
+			total += freq;
+		}
+
+		if (total == 0) {
+			return 0;
+		}
+
+		return static_cast<double>(code.getEncodedBits(byteFreqs)) / total;
+	}
+
+private:
+	SampledTable()
+	{
+	}
+};
\ No newline at end of file
@@ -3,6 +3,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 class RAIIFileHandler 
 {
@@ -13,14 +21,17 @@ private:
 	using string = std::string;
 
 public:
-	RAIIFileHandler(const string& path, ios::openmode openMode = DEFAULT_OPEN_MODE)
-		: file(path, openMode)
+	RAIIFileHandler(const string& path, ios::openmode openMode = DEFAULT_OPEN_MODE, 
+		size_t bufferSize = BUFFER_SIZE)
+		: buffer(bufferSize)
 	{
+		// The buffer has to be set before the file is opened to take effect
+		file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+		file.open(path, openMode);
+
 		if (!file.is_open()) {
 			throw std::runtime_error("Failed to open file: " + path);
 		}
-
-		file.rdbuf()->pubsetbuf(buffer, BUFFER_SIZE);
 	}
 
 	~RAIIFileHandler() 
@@ -44,6 +55,46 @@ private:
 	static constexpr ios::openmode DEFAULT_OPEN_MODE = ios::binary | ios::in | ios::out;
 	static constexpr size_t BUFFER_SIZE = 1024;
 
+	std::vector<char> buffer;
 	fstream file;
-	char buffer[BUFFER_SIZE];
+};
+
+// Exclusive advisory lock on a file (created if missing), held until the 
+// handler goes out of scope. Other holders of the lock wait for it.
+class RAIIFileLock
+{
+private:
+	// Alias declarations
+	using string = std::string;
+
+public:
+	RAIIFileLock(const string& path)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+		if (fd < 0) {
+			throw std::runtime_error("Failed to open file: " + path);
+		}
+
+		if (flock(fd, LOCK_EX) != 0) {
+			close(fd);
+			throw std::runtime_error("Failed to lock file: " + path);
+		}
+#endif
+	}
+
+	RAIIFileLock(const RAIIFileLock&) = delete;
+	RAIIFileLock& operator=(const RAIIFileLock&) = delete;
+
+	~RAIIFileLock()
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		// Closing the descriptor releases the lock
+		close(fd);
+#endif
+	}
+
+private:
+	int fd = -1;
 };
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <filesystem>
+
+#include "../src/huffman.hpp"
+#include "../src/incremental-decoder.hpp"
+
+namespace fs = std::filesystem;
+
+// Bytes after the compressed data, which the decoder must leave alone
+static const std::vector<Byte> TRAILER(64, 0xA5);
+static const size_t NUM_SEEDS = 4;
+static const size_t CHUNK_SIZES[] = { 1, 7, 300, 1 << 16 };
+
+static int numFailures = 0;
+
+// Words with a skewed distribution and a limited alphabet, which every
+// format (the original one included) can take
+std::vector<Byte> makeText(size_t size, unsigned seed) {
+	static const std::string WORDS[] = { "the ", "block ", "huffman ", "table ", "of ", "a ",
+		"decoder\n", "stream ", "code ", "bits " };
+	std::mt19937 rng(seed);
+	std::vector<Byte> data;
+
+	while (data.size() < size) {
+		const std::string& word = WORDS[std::min<size_t>(rng() % 16, 9)];
+		data.insert(data.end(), word.begin(), word.end());
+	}
+	data.resize(size);
+	return data;
+}
+
+// Text, runs of a single byte and random bytes, so that blocks of all
+// types and table reuse show up
+std::vector<Byte> makeMixed(size_t size, unsigned seed) {
+	std::mt19937 rng(seed);
+	std::vector<Byte> data = makeText(size / 2, seed);
+
+	data.insert(data.end(), size / 8, 'z');
+	while (data.size() < size - size / 8) {
+		data.push_back(static_cast<Byte>(rng()));
+	}
+
+	std::vector<Byte> text = makeText(size - data.size(), seed + 1);
+	data.insert(data.end(), text.begin(), text.end());
+	return data;
+}
+
+std::vector<Byte> compress(const std::vector<Byte>& data, const CompressionOptions& options) {
+	std::stringstream inStream(std::string(data.begin(), data.end()));
+	std::stringstream outStream;
+
+	Compressor::zip(inStream, outStream, options);
+
+	std::string compressed = outStream.str();
+	return std::vector<Byte>(compressed.begin(), compressed.end());
+}
+
+// Compresses the parts one after the other into the same file with appends
+std::vector<Byte> compressAppended(const std::vector<std::vector<Byte>>& parts, const BlockSettings& settings) {
+	fs::path dir = fs::temp_directory_path();
+	fs::path inPath = dir / "incremental-decoder-test.in";
+	fs::path outPath = dir / "incremental-decoder-test.hzip";
+
+	fs::remove(outPath);
+
+	for (const std::vector<Byte>& part : parts) {
+		std::ofstream(inPath, std::ios::binary).write(reinterpret_cast<const char*>(part.data()), part.size());
+		Compressor::append(inPath.string(), outPath.string(), settings);
+	}
+
+	std::ifstream outFile(outPath, std::ios::binary);
+	std::vector<Byte> compressed((std::istreambuf_iterator<char>(outFile)), {});
+
+	fs::remove(inPath);
+	fs::remove(outPath);
+	return compressed;
+}
+
+// Feeds the compressed data followed by TRAILER in random chunks, to random
+// sized output buffers
+void check(const std::string& name, const std::vector<Byte>& compressed, const std::vector<Byte>& expected) {
+	std::vector<Byte> input(compressed);
+	input.insert(input.end(), TRAILER.begin(), TRAILER.end());
+
+	for (size_t chunkSize : CHUNK_SIZES) {
+		for (unsigned seed = 0; seed < NUM_SEEDS; seed++) {
+			std::mt19937 rng(seed);
+			IncrementalDecoder decoder;
+			std::vector<Byte> output;
+			std::vector<Byte> outBuff(chunkSize);
+			size_t pos = 0;
+			DecodeStatus status = DecodeStatus::NEED_INPUT;
+			std::string error;
+
+			while (error.empty()) {
+				size_t inSize = std::min<size_t>(rng() % (chunkSize + 1), input.size() - pos);
+				size_t outSize = rng() % (chunkSize + 1);
+				size_t inUsed, outUsed;
+
+				status = decoder.decode(input.data() + pos, inSize, inUsed, outBuff.data(), outSize, outUsed);
+				pos += inUsed;
+				output.insert(output.end(), outBuff.begin(), outBuff.begin() + outUsed);
+
+				if (status == DecodeStatus::DONE) {
+					break;
+				}
+
+				if (status == DecodeStatus::NEED_INPUT && inUsed != inSize) {
+					error = "NEED_INPUT with input left";
+				}
+				else if (status == DecodeStatus::NEED_OUTPUT && outUsed != outSize) {
+					error = "NEED_OUTPUT with room left";
+				}
+				else if (pos == input.size() && status == DecodeStatus::NEED_INPUT) {
+					error = "no end found";
+				}
+			}
+
+			if (error.empty() && pos < compressed.size()) {
+				error = "stopped " + std::to_string(compressed.size() - pos) + " bytes before the end";
+			}
+			else if (error.empty() && pos > compressed.size()) {
+				error = "consumed " + std::to_string(pos - compressed.size()) + " trailing bytes";
+			}
+			else if (error.empty() && output != expected) {
+				error = "wrong output";
+			}
+
+			if (!error.empty()) {
+				std::cout << "FAIL " << name << " (chunks " << chunkSize << ", seed " << seed << "): " <<
+					error << std::endl;
+				numFailures++;
+				return;
+			}
+		}
+	}
+
+	std::cout << "ok " << name << std::endl;
+}
+
+int main() {
+	std::vector<Byte> empty;
+	std::vector<Byte> text = makeText(100000, 1);
+	std::vector<Byte> mixed = makeMixed(100000, 2);
+
+	// Small blocks, so that the data spans many of them
+	BlockSettings small = CompressionLevel::getSettings(6);
+	small.blockSize = 4096;
+
+	check("original", compress(text, { CompressionMode::STATIC }), text);
+
+	for (const std::vector<Byte>* data : { &empty, &text, &mixed }) {
+		std::string suffix = (data == &empty) ? " empty" : (data == &text) ? " text" : " mixed";
+
+		check("adaptive" + suffix, compress(*data, { CompressionMode::ADAPTIVE }), *data);
+
+		for (int level : { 1, 6, 9 }) {
+			check("level " + std::to_string(level) + suffix,
+				compress(*data, { CompressionMode::BLOCKS, CompressionLevel::getSettings(level) }), *data);
+		}
+
+		for (EntropyMode entropyMode : { EntropyMode::HUFFMAN, EntropyMode::FSE, EntropyMode::AUTO }) {
+			BlockSettings settings = small;
+			settings.entropyMode = entropyMode;
+			check("entropy " + std::to_string(static_cast<int>(entropyMode)) + suffix,
+				compress(*data, { CompressionMode::BLOCKS, settings }), *data);
+		}
+
+		check("sampled" + suffix, compress(*data, { CompressionMode::SAMPLED, small }), *data);
+	}
+
+	// Each append leaves an index behind, the last one ends the data
+	std::vector<Byte> appended(text);
+	appended.insert(appended.end(), mixed.begin(), mixed.end());
+	appended.insert(appended.end(), text.begin(), text.end());
+	check("appended", compressAppended({ text, mixed, empty, text }, small), appended);
+
+	return (numFailures == 0) ? 0 : 1;
+}
\ No newline at end of file
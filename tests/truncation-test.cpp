@@ -0,0 +1,124 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+
+#include "../src/huffman.hpp"
+
+static int numFailures = 0;
+
+std::string makeData(size_t size) {
+	static const std::string WORDS[] = { "the ", "block ", "huffman ", "table ", "of ", "a ",
+		"decoder\n", "stream ", "code ", "bits " };
+	std::mt19937 rng(1);
+	std::string data;
+
+	while (data.size() < size) {
+		data += WORDS[std::min<size_t>(rng() % 16, 9)];
+		if (rng() % 64 == 0) {
+			data += static_cast<char>(rng());
+		}
+	}
+	data.resize(size);
+	return data;
+}
+
+std::string compress(const std::string& data, const CompressionOptions& options) {
+	std::stringstream inStream(data);
+	std::stringstream outStream;
+
+	Compressor::zip(inStream, outStream, options);
+	return outStream.str();
+}
+
+// Returns the error of the batch decoder, empty if it succeeded. The size
+// of the output is returned as well.
+std::string decompress(const std::string& compressed, size_t& outSize) {
+	std::stringstream inStream(compressed);
+	std::stringstream outStream;
+	std::string error;
+
+	try {
+		Decompressor::unzip(inStream, outStream);
+	}
+	catch (std::exception& e) {
+		error = e.what();
+	}
+
+	outSize = outStream.str().size();
+	return error;
+}
+
+void check(const std::string& name, const std::string& compressed, size_t dataSize) {
+	size_t outSize;
+
+	if (!decompress(compressed, outSize).empty() || outSize != dataSize) {
+		std::cout << "FAIL " << name << ": the complete file doesn't decode" << std::endl;
+		numFailures++;
+		return;
+	}
+
+	// Every cut after the header must be reported, wherever it falls.
+	// Without the header the data reads as the original format.
+	for (size_t size = 3; size < compressed.size(); size += 1 + size / 16) {
+		if (decompress(compressed.substr(0, size), outSize).empty()) {
+			std::cout << "FAIL " << name << ": cut to " << size << " of " << compressed.size() <<
+				" bytes decodes without an error" << std::endl;
+			numFailures++;
+			return;
+		}
+	}
+
+	if (decompress(compressed.substr(0, compressed.size() - 1), outSize).empty()) {
+		std::cout << "FAIL " << name << ": missing last byte decodes without an error" << std::endl;
+		numFailures++;
+		return;
+	}
+
+	std::cout << "ok " << name << std::endl;
+}
+
+int main() {
+	std::string data = makeData(200000);
+
+	std::string adaptive = compress(data, { CompressionMode::ADAPTIVE });
+	check("adaptive", adaptive, data.size());
+
+	BlockSettings settings = CompressionLevel::getSettings(6);
+	settings.blockSize = 4096;
+	check("blocks", compress(data, { CompressionMode::BLOCKS, settings }), data.size());
+
+	// A size field that claims far more bytes than the data holds must stop
+	// at the end of the input instead of decoding zeros without end. The
+	// size follows the magic and the mode byte.
+	std::string oversized(adaptive);
+	oversized[3] ^= 0x40;
+
+	size_t outSize;
+	if (decompress(oversized, outSize).empty() || outSize > 2 * data.size()) {
+		std::cout << "FAIL adaptive size field: " << outSize << " bytes decoded" << std::endl;
+		numFailures++;
+	}
+	else {
+		std::cout << "ok adaptive size field" << std::endl;
+	}
+
+	// A payload size far beyond what the block could need must be rejected
+	// before a buffer is allocated for it
+	std::string oversizedPayload = compress(data.substr(0, 4096), { CompressionMode::BLOCKS, settings });
+	for (size_t i = 0; i < 4; i++) {
+		oversizedPayload[ContainerFormat::BLOCKS_HEADER_SIZE + 7 + i] = static_cast<char>(0xFF);
+	}
+
+	std::string error = decompress(oversizedPayload, outSize);
+	if (error != "Corrupted block header.") {
+		std::cout << "FAIL blocks payload size: " << (error.empty() ? "no error" : error) << std::endl;
+		numFailures++;
+	}
+	else {
+		std::cout << "ok blocks payload size" << std::endl;
+	}
+
+	return (numFailures == 0) ? 0 : 1;
+}
\ No newline at end of file